@@ -0,0 +1,614 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+// gbench
+// Throughput benchmark for gParse. Generates synthetic corpora in memory and
+// times the tokenizer, the token cache, the pattern engine and the hash table
+// on them. Results are printed one per line as JSON (default) or CSV so they
+// can be collected and compared between releases.
+//
+// Usage: gbench [-c corpora] [-s sizes] [-b benches] [-r reps] [-f json|csv]
+//
+//   -c  Comma separated corpora: clike,config,numeric,comment,string
+//       (default: all)
+//   -s  Comma separated sizes with an optional K, M or G suffix
+//       (default: 64K,1M,16M)
+//   -b  Comma separated benches: next,token,pattern,pipeline,hash 
+//       (default: all)
+//   -r  Repetitions, the fastest is reported (default: 3)
+//   -f  Output format (default: json)
+
+#include "gparse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+
+
+// ----------------------------------------------------------------------------
+// Timing
+
+static double now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+// ----------------------------------------------------------------------------
+// Corpus generation
+// Everything is generated from a fixed seed so runs are comparable.
+
+static unsigned int seed;
+
+static unsigned int rnd(unsigned int range)
+{
+   seed ^= seed << 13;
+   seed ^= seed >> 17;
+   seed ^= seed << 5;
+   return seed % range;
+}
+
+
+static const char *words[] = {
+   "alpha", "beta", "gamma", "delta", "count", "index", "value", "buffer",
+   "length", "result", "node", "next", "prev", "table", "item", "key",
+   "name", "size", "offset", "flags", "state", "stream", "token", "line",
+};
+#define NUMWORDS (sizeof(words) / sizeof(words[0]))
+
+
+typedef struct
+{
+   char     *buffer;
+   size_t   length, max;
+} corpus_t;
+
+static void put(corpus_t *c, const char *str)
+{
+   size_t len = strlen(str);
+
+   if(c->length + len + 1 > c->max)
+   {
+      c->max = (c->max + len + 1) * 2;
+      c->buffer = (char *)realloc(c->buffer, c->max);
+      if(!c->buffer)
+      {
+         fprintf(stderr, "gbench: out of memory\n");
+         exit(1);
+      }
+   }
+
+   memcpy(c->buffer + c->length, str, len + 1);
+   c->length += len;
+}
+
+
+static void putIdent(corpus_t *c)
+{
+   char buf[64];
+
+   sprintf(buf, "%s_%u", words[rnd(NUMWORDS)], rnd(1000));
+   put(c, buf);
+}
+
+
+static void putNumber(corpus_t *c)
+{
+   char buf[64];
+
+   switch(rnd(4))
+   {
+      case 0: sprintf(buf, "%u", rnd(100000)); break;
+      case 1: sprintf(buf, "%u.%u", rnd(1000), rnd(1000)); break;
+      case 2: sprintf(buf, "%u.%ue%u", rnd(10), rnd(1000), rnd(30)); break;
+      default: sprintf(buf, "0x%X", rnd(0x10000)); break;
+   }
+   put(c, buf);
+}
+
+
+// Each generator appends one chunk (a function, a section, a row...).
+
+static void genCLike(corpus_t *c)
+{
+   int i, n = 2 + rnd(6);
+
+   put(c, "int "); putIdent(c); put(c, "(int "); putIdent(c); put(c, ", char *"); putIdent(c); put(c, ")\n{\n");
+
+   for(i = 0; i < n; i++)
+   {
+      switch(rnd(4))
+      {
+         case 0:
+            put(c, "   int "); putIdent(c); put(c, " = "); putIdent(c); put(c, " * "); putNumber(c); put(c, ";\n");
+            break;
+         case 1:
+            put(c, "   if("); putIdent(c); put(c, " > "); putNumber(c); put(c, ")\n      return "); putIdent(c); put(c, " - 1;\n");
+            break;
+         case 2:
+            put(c, "   printf(\"value %d\\n\", "); putIdent(c); put(c, ");\n");
+            break;
+         default:
+            put(c, "   "); putIdent(c); put(c, "["); putIdent(c); put(c, "] += "); putNumber(c); put(c, "; // update\n");
+            break;
+      }
+   }
+
+   put(c, "}\n\n");
+}
+
+
+static void genConfig(corpus_t *c)
+{
+   int i, n = 2 + rnd(10);
+
+   putIdent(c); put(c, " = "); put(c, "1;\n");
+   put(c, "section {\n");
+
+   for(i = 0; i < n; i++)
+   {
+      char buf[32];
+
+      put(c, "   "); putIdent(c); sprintf(buf, " = %u;\n", rnd(100000)); put(c, buf);
+   }
+
+   put(c, "}\n");
+}
+
+
+static void genNumeric(corpus_t *c)
+{
+   int i;
+
+   for(i = 0; i < 12; i++)
+   {
+      putNumber(c);
+      put(c, i < 11 ? ", " : ";\n");
+   }
+}
+
+
+static void genComment(corpus_t *c)
+{
+   int i, n = 1 + rnd(4);
+
+   put(c, "/*\n");
+   for(i = 0; i < n; i++)
+   {
+      put(c, " * "); put(c, words[rnd(NUMWORDS)]); put(c, " describes how "); putIdent(c); 
+      put(c, " relates to the "); put(c, words[rnd(NUMWORDS)]); put(c, " of this block.\n");
+   }
+   put(c, " */\n");
+
+   put(c, "// "); put(c, words[rnd(NUMWORDS)]); put(c, " "); put(c, words[rnd(NUMWORDS)]); put(c, "\n");
+   putIdent(c); put(c, " = "); putNumber(c); put(c, ";\n");
+}
+
+
+static void genString(corpus_t *c)
+{
+   int i, n = 1 + rnd(12);
+
+   putIdent(c); put(c, " = \"");
+   for(i = 0; i < n; i++)
+   {
+      put(c, words[rnd(NUMWORDS)]);
+      switch(rnd(6))
+      {
+         case 0: put(c, "\\n"); break;
+         case 1: put(c, "\\\"quoted\\\" "); break;
+         case 2: put(c, "\\t"); break;
+         default: put(c, " "); break;
+      }
+   }
+   put(c, "\";\n");
+}
+
+
+typedef struct
+{
+   const char  *name;
+   void        (*gen)(corpus_t *);
+} corpusdef_t;
+
+static corpusdef_t corpora[] = {
+   {"clike",   genCLike},
+   {"config",  genConfig},
+   {"numeric", genNumeric},
+   {"comment", genComment},
+   {"string",  genString},
+   {NULL, NULL},
+};
+
+
+static corpus_t makeCorpus(const corpusdef_t *def, size_t size)
+{
+   corpus_t c;
+
+   memset(&c, 0, sizeof(c));
+   seed = 0x2545F491;
+
+   while(c.length < size)
+      def->gen(&c);
+
+   return c;
+}
+
+
+// ----------------------------------------------------------------------------
+// Tokenizer setup
+
+enum
+{
+   tEq = tLastBaseToken, tSemi, tComma, tLBrace, tRBrace, tLParen, tRParen,
+   tLBracket, tRBracket, tPlus, tMinus, tStar, tSlash, tLess, tGreater, tPlusEq,
+   tKeyword,
+};
+
+static gSymbol symbols[] = {
+   {"+=", tPlusEq}, {"=", tEq}, {";", tSemi}, {",", tComma}, {"{", tLBrace}, {"}", tRBrace},
+   {"(", tLParen}, {")", tRParen}, {"[", tLBracket}, {"]", tRBracket}, {"+", tPlus},
+   {"-", tMinus}, {"*", tStar}, {"/", tSlash}, {"<", tLess}, {">", tGreater},
+   {""},
+};
+
+static gKeyword keywords[] = {
+   {"int", tKeyword, NULL}, {"char", tKeyword, NULL}, {"if", tKeyword, NULL},
+   {"return", tKeyword, NULL}, {"section", tKeyword, NULL},
+   {NULL},
+};
+
+static gEscape escapes[] = {
+   {'n', '\n'}, {'t', '\t'}, {'\"', '\"'}, {'\\', '\\'},
+   {0},
+};
+
+static gTokenParms *parms;
+
+static gTokenStream *openStream(const corpus_t *c)
+{
+   gTextStream *text = gStreamFromMemory(c->buffer, (int)c->length, false);
+
+   return gCreateTokenStream(parms, text, "bench");
+}
+
+static void closeStream(gTokenStream *ts)
+{
+   gTextStream *text = ts->stream;
+
+   gFreeTokenStream(ts);
+   gFreeStream(text);
+}
+
+
+// ----------------------------------------------------------------------------
+// Benches
+// Each returns the number of items processed (tokens or table operations).
+
+static double benchNext(const corpus_t *c)
+{
+   gTokenStream   *ts = openStream(c);
+   gToken         *t;
+   double         count = 0;
+
+   while((t = gGetNextToken(ts))->type != tEOF)
+   {
+      count++;
+      gFreeToken(t);
+   }
+   gFreeToken(t);
+
+   closeStream(ts);
+   return count;
+}
+
+
+static double benchToken(const corpus_t *c)
+{
+   gTokenStream   *ts = openStream(c);
+   gToken         *t;
+   int            i;
+
+   // Keep the cache small the way a parser with bounded lookahead would.
+   for(i = 0; (t = gGetToken(ts, i)) && t->type != tEOF; i++)
+   {
+      if((i & 4095) == 4095)
+         gClearTCache(ts);
+   }
+
+   closeStream(ts);
+   return i;
+}
+
+
+// Grammar of the config corpus: assignments and nested sections.
+static tpStep configSteps[] = {
+   {"top",     opCompType, tEOF,       scEnd,                  scSkip,  NULL,      NULL, NULL, 0, NULL},
+   {NULL,      opCompType, tKeyword,   scNext,                 scSkip,  NULL,      NULL, NULL, 0, NULL},
+   {NULL,      opCompType, tLBrace,    scPush|sfBack,          scSkip,  "block",   NULL, NULL, 0, NULL},
+   {NULL,      opNoComp,   0,          scPush|sfBack|sfStay,   0,       "stmt",    NULL, NULL, 0, NULL},
+   {"block",   opCompType, tRBrace,    scPop,                  scSkip,  NULL,      NULL, NULL, 0, NULL},
+   {NULL,      opNoComp,   0,          scPush|sfBack|sfStay,   0,       "stmt",    NULL, NULL, 0, NULL},
+   {"stmt",    opCompType, tIdentifier,scNext,                 scThrow, NULL,      NULL, NULL, tpError, "expected identifier, got '%s'"},
+   {NULL,      opCompType, tEq,        scNext,                 scThrow, NULL,      NULL, NULL, tpError, "expected '=' got '%s'"},
+   {NULL,      opCompType, tInteger,   scNext,                 scThrow, NULL,      NULL, NULL, tpError, "expected number got '%s'"},
+   {NULL,      opCompType, tSemi,      scPop,                  scThrow, NULL,      NULL, NULL, tpError, "expected ';' got '%s'"},
+   {NULL},
+};
+
+static double runPattern(const corpus_t *c, bool pipelined)
+{
+   gTokenStream   *ts = openStream(c);
+   gTextStream    *text = ts->stream;
+   tPattern       *p = tpNewPattern(configSteps, ts);
+   double         count;
+
+   if(pipelined)
+      gStartTokenPipeline(ts, 0);
+
+   if(tpExecutePattern(p) != tpNoError)
+      fprintf(stderr, "gbench: pattern failed at token %d\n", p->i);
+
+   count = p->i;
+
+   // tpFreePattern frees the token stream.
+   tpFreePattern(p);
+   gFreeStream(text);
+   return count;
+}
+
+static double benchPattern(const corpus_t *c)
+{
+   return runPattern(c, false);
+}
+
+// Same, with the lexer on its own thread.
+static double benchPipeline(const corpus_t *c)
+{
+   return runPattern(c, true);
+}
+
+
+// Adds every identifier of the corpus to a table, looks each one up twice 
+// and removes them again.
+static double benchHash(const corpus_t *c)
+{
+   gTokenStream   *ts = openStream(c);
+   gHashTable     *table = gNewHashTable(1021, NULL, false);
+   gList          *keys = gNewList(gFreeToken);
+   gToken         *t;
+   double         ops = 0;
+   int            i, n;
+
+   while((t = gGetNextToken(ts))->type != tEOF)
+   {
+      if(t->type == tIdentifier)
+         gAppendListItem(keys, t);
+      else
+         gFreeToken(t);
+   }
+   gFreeToken(t);
+   closeStream(ts);
+
+   n = gGetListSize(keys);
+
+   for(i = 0; i < n; i++, ops++)
+      gAddTableItem(table, ((gToken *)gGetListItem(keys, i))->token, keys);
+
+   for(i = 0; i < n * 2; i++, ops++)
+      gFindTableItem(table, ((gToken *)gGetListItem(keys, i % n))->token);
+
+   for(i = 0; i < n; i++, ops++)
+      gRemoveTableItem(table, ((gToken *)gGetListItem(keys, i))->token);
+
+   gFreeHashTable(table);
+   gFreeList(keys);
+   return ops;
+}
+
+
+typedef struct
+{
+   const char  *name;
+   double      (*run)(const corpus_t *);
+   const char  *corpus;    // Only run on this corpus if set
+   const char  *unit;      // What the items are
+} benchdef_t;
+
+static benchdef_t benches[] = {
+   {"gGetNextToken",    benchNext,     NULL,       "tokens"},
+   {"gGetToken",        benchToken,    NULL,       "tokens"},
+   {"tpExecutePattern", benchPattern,  "config",   "tokens"},
+   {"gTokenPipeline",   benchPipeline, "config",   "tokens"},
+   {"gHashTable",       benchHash,     "clike",    "ops"},
+   {NULL, NULL, NULL, NULL},
+};
+
+static const char *benchkeys[] = {"next", "token", "pattern", "pipeline", "hash"};
+
+
+// ----------------------------------------------------------------------------
+// Driver
+
+static bool inList(const char *list, const char *name)
+{
+   size_t len = strlen(name);
+   const char *p;
+
+   if(!list)
+      return true;
+
+   for(p = list; (p = strstr(p, name)); p += len)
+   {
+      if((p == list || p[-1] == ',') && (p[len] == ',' || p[len] == 0))
+         return true;
+   }
+
+   return false;
+}
+
+
+// Text streams take an int length. A generator overshoots the size by at 
+// most one statement, so the largest size keeps well clear of INT_MAX.
+#define MAX_SIZE ((size_t)INT_MAX - 65536)
+
+
+static size_t parseSize(const char *str, char **end)
+{
+   double size = strtod(str, end);
+
+   switch(**end)
+   {
+      case 'k': case 'K': size *= 1024.0; (*end)++; break;
+      case 'm': case 'M': size *= 1024.0 * 1024.0; (*end)++; break;
+      case 'g': case 'G': size *= 1024.0 * 1024.0 * 1024.0; (*end)++; break;
+   }
+
+   // Anything too large is reported by main, without overflowing the cast.
+   if(size > (double)MAX_SIZE)
+      return MAX_SIZE + 1;
+
+   return (size_t)size;
+}
+
+
+static void usage(void)
+{
+   fprintf(stderr, "usage: gbench [-c corpora] [-s sizes] [-b benches] [-r reps] [-f json|csv]\n");
+   exit(1);
+}
+
+
+int main(int argc, char **argv)
+{
+   const char  *corpuslist = NULL, *benchlist = NULL, *sizelist = "64K,1M,16M";
+   int         reps = 3, i, j, r;
+   bool        csv = false;
+   const char  *s;
+   char        *end;
+
+   for(i = 1; i < argc; i++)
+   {
+      if(i + 1 >= argc || argv[i][0] != '-')
+         usage();
+
+      switch(argv[i][1])
+      {
+         case 'c': corpuslist = argv[++i]; break;
+         case 's': sizelist = argv[++i]; break;
+         case 'b': benchlist = argv[++i]; break;
+         case 'r': reps = atoi(argv[++i]); break;
+         case 'f': csv = !strcmp(argv[++i], "csv"); break;
+         default: usage();
+      }
+   }
+
+   if(reps < 1)
+      reps = 1;
+
+   parms = gNewParms();
+   parms->symbollist = symbols;
+   parms->keywlist = keywords;
+   parms->escapelist = escapes;
+
+   if(csv)
+      printf("bench,corpus,size,bytes,items,unit,seconds,mb_per_s,items_per_s\n");
+
+   for(s = sizelist; *s; s = *end ? end + 1 : end)
+   {
+      size_t size = parseSize(s, &end);
+
+      if(!size || (*end && *end != ','))
+         usage();
+
+      if(size > MAX_SIZE)
+      {
+         fprintf(stderr, "gbench: size %.*s is too large, the limit is %lu bytes\n", 
+                 (int)(end - s), s, (unsigned long)MAX_SIZE);
+         exit(1);
+      }
+
+      for(i = 0; corpora[i].name; i++)
+      {
+         corpus_t c;
+
+         if(!inList(corpuslist, corpora[i].name))
+            continue;
+
+         c = makeCorpus(&corpora[i], size);
+
+         for(j = 0; benches[j].name; j++)
+         {
+            double best = 0, items = 0, mbps;
+
+            if(!inList(benchlist, benchkeys[j]))
+               continue;
+            if(benches[j].corpus && strcmp(benches[j].corpus, corpora[i].name))
+               continue;
+
+            for(r = 0; r < reps; r++)
+            {
+               double start = now(), elapsed;
+
+               items = benches[j].run(&c);
+               elapsed = now() - start;
+
+               if(r == 0 || elapsed < best)
+                  best = elapsed;
+            }
+
+            if(best <= 0)
+               best = 1e-9;
+
+            mbps = c.length / (1024.0 * 1024.0) / best;
+
+            if(csv)
+               printf("%s,%s,%lu,%lu,%.0f,%s,%.6f,%.2f,%.0f\n", benches[j].name, corpora[i].name,
+                      (unsigned long)size, (unsigned long)c.length, items, benches[j].unit,
+                      best, mbps, items / best);
+            else
+               printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"size\":%lu,\"bytes\":%lu,\"items\":%.0f,"
+                      "\"unit\":\"%s\",\"seconds\":%.6f,\"mb_per_s\":%.2f,\"items_per_s\":%.0f}\n",
+                      benches[j].name, corpora[i].name, (unsigned long)size, (unsigned long)c.length,
+                      items, benches[j].unit, best, mbps, items / best);
+            fflush(stdout);
+         }
+
+         free(c.buffer);
+      }
+   }
+
+   gFreeParms(parms);
+   return 0;
+}
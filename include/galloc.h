@@ -0,0 +1,143 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+#ifndef GALLOC_H
+#define GALLOC_H
+
+/**
+ * \file galloc.h
+ * \brief Pluggable memory allocation.
+ *
+ * Every allocation made by gParse goes through a gAllocator. There is one 
+ * global allocator (by default a thin wrapper over malloc, realloc and free)
+ * which objects pick up when they are created. Token streams and patterns 
+ * can be given their own allocator, which is then used for everything they
+ * allocate, including the tokens they hand out.
+ *
+ * An object keeps a pointer to the allocator it was created with and frees
+ * its memory through it, so the gAllocator struct must stay valid until all
+ * objects using it are freed.
+*/
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * \struct gAllocator
+ * \brief Allocation functions plus a context pointer passed to each of them.
+ *
+ * The functions behave like malloc, realloc and free. realloc is called with
+ * a NULL ptr to allocate and free may be called with NULL.
+*/
+typedef struct gAllocator
+{
+   void *(*alloc)(void *context, size_t size);               //!< Allocate size bytes
+   void *(*realloc)(void *context, void *ptr, size_t size);  //!< Resize a block
+   void  (*free)(void *context, void *ptr);                  //!< Release a block
+   void  *context;                                           //!< Passed to all three functions
+} gAllocator;
+
+
+/**
+ * \fn void gSetAllocator(const gAllocator *allocator)
+ * \brief Sets the global allocator.
+ *
+ * Objects created afterwards use the new allocator, existing objects keep the
+ * one they were created with. Not thread safe, set it before creating 
+ * objects on other threads.
+ *
+ * @param[in] allocator New global allocator, or NULL for the default.
+*/
+void gSetAllocator(const gAllocator *allocator);
+
+
+/**
+ * \fn const gAllocator *gGetAllocator(void)
+ * \brief Returns the global allocator.
+*/
+const gAllocator *gGetAllocator(void);
+
+
+/**
+ * \fn void *gAlloc(const gAllocator *allocator, size_t size)
+ * \brief Allocates memory. A NULL allocator means the global one.
+*/
+void *gAlloc(const gAllocator *allocator, size_t size);
+
+
+/**
+ * \fn void *gRealloc(const gAllocator *allocator, void *ptr, size_t size)
+ * \brief Resizes memory. A NULL allocator means the global one.
+*/
+void *gRealloc(const gAllocator *allocator, void *ptr, size_t size);
+
+
+/**
+ * \fn void gFree(const gAllocator *allocator, void *ptr)
+ * \brief Frees memory. A NULL allocator means the global one.
+*/
+void gFree(const gAllocator *allocator, void *ptr);
+
+
+/**
+ * \fn char *gStrdup(const gAllocator *allocator, const char *str)
+ * \brief Copies a string. Returns NULL if str is NULL.
+*/
+char *gStrdup(const gAllocator *allocator, const char *str);
+
+
+/**
+ * \fn void *gAllocObject(const gAllocator *allocator, size_t size)
+ * \brief Allocates memory which remembers its allocator.
+ *
+ * Used for objects freed through a plain void (*)(void *) function, like
+ * the free functions of gList and gStack, which have no way to be told the
+ * allocator. Free the memory with gFreeObject.
+*/
+void *gAllocObject(const gAllocator *allocator, size_t size);
+
+
+/**
+ * \fn void gFreeObject(void *object)
+ * \brief Frees memory allocated with gAllocObject (does nothing for NULL).
+*/
+void gFreeObject(void *object);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
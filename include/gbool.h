@@ -30,17 +30,28 @@
 #ifndef GBOOL_H
 #define GBOOL_H
 
-#ifndef __cplusplus
-
 /**
  * \file gbool.h
  * \brief Provides a bool type for C environments
  *
  * This file simply provides a bool typedef and marcros for true and false
- * for the C environment. If __cplusplus is defined, this file does nothing.
+ * for the C environment. If __cplusplus is defined, only guint64 is defined.
 */
 
 
+/**
+ * \typedef guint64
+ * \brief Unsigned 64 bit integer. VC6 has no long long.
+*/
+#if defined(_MSC_VER) && _MSC_VER < 1300
+typedef unsigned __int64 guint64;
+#else
+typedef unsigned long long guint64;
+#endif
+
+
+#ifndef __cplusplus
+
 typedef int bool; //!< Boolean type definition
 
 #define true 1    //!< Boolean true
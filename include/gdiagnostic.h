@@ -0,0 +1,231 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+#ifndef GDIAGNOSTIC_H
+#define GDIAGNOSTIC_H
+
+/**
+ * \file gdiagnostic.h
+ * \brief Structured diagnostics.
+ *
+ * Errors and warnings from the tokenizer and the pattern engine are stored 
+ * as gDiagnostic records in a gDiagBuffer owned by the token stream. A 
+ * record holds a code, a severity, a position and the arguments of the 
+ * message. Nothing is formatted until gFormatDiagnostic is called, so inputs 
+ * producing thousands of errors cost little more than the records.
+*/
+
+#include "gbool.h"
+#include "galloc.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * \enum gDiagSeverity_e
+ * \brief Severity of a diagnostic.
+*/
+typedef enum
+{
+   gdNote,        //!< Information, eg. the error summary of a pattern
+   gdWarning,     //!< Warning
+   gdError,       //!< Error, processing continued
+   gdFatal        //!< Error that stopped processing
+} gDiagSeverity_e;
+
+
+/**
+ * \enum gDiagCode_e
+ * \brief Diagnostic codes.
+ *
+ * The comment of each code lists the arguments the record carries.
+*/
+typedef enum
+{
+   gdUnterminatedString,   //!< String literal runs to the end of the line or stream
+   gdExpectedHex,          //!< '0x' not followed by hex digits
+   gdExpectedExponent,     //!< Exponent of a number has no digits
+   gdUnknownChar,          //!< Char that can't start any token
+   gdPatternThrow,         //!< Error thrown by a pattern step. sarg[0]: message format, sarg[1]: token
+   gdPatternNoLabel,       //!< Step requiring a label had none. iarg[0]: step index
+   gdPatternBadLabel,      //!< Label not found in pattern. sarg[0]: label, iarg[0]: step index
+   gdPatternBadOp,         //!< Step action code unknown. iarg[0]: step index
+   gdPatternEOF,           //!< Stream ended inside a pattern
+   gdPatternSummary,       //!< Error and warning count. iarg[0]: errors, iarg[1]: warnings
+   gdCannotOpen            //!< File given to gParseFiles couldn't be opened
+} gDiagCode_e;
+
+
+/**
+ * \struct gDiagnostic
+ * \brief A single diagnostic record.
+ *
+ * String arguments are copies owned by the buffer and are valid until the 
+ * buffer is cleared or freed. stream points to the name of the token stream.
+ *
+ * The records themselves are kept in one array that is reallocated as it 
+ * grows, so a pointer to a record is only valid until the next record is 
+ * added. Copy the struct to keep it longer; the copy's strings stay valid 
+ * until the buffer is cleared or freed.
+*/
+typedef struct gDiagnostic
+{
+   int         code;       //!< gDiagCode_e
+   int         severity;   //!< gDiagSeverity_e
+   const char  *stream;    //!< Name of the stream the diagnostic belongs to
+   int         linenum;    //!< Line number (0 if not tied to a position)
+   int         charnum;    //!< Char number (0 if not tied to a position)
+   const char  *sarg[2];   //!< String arguments (may be NULL)
+   int         iarg[2];    //!< Integer arguments
+   void        *context;   //!< Context pointer of the buffer at the time the record was added
+} gDiagnostic;
+
+
+/**
+ * \typedef gDiagSink
+ * \brief Called for each diagnostic as it's added.
+ *
+ * @param[in] diag The new record. Only valid until the next record is added,
+ *                 a sink that keeps records must copy the struct.
+ * @param[in] context Context pointer given to gSetDiagnosticSink.
+*/
+typedef void (*gDiagSink)(const gDiagnostic *diag, void *context);
+
+
+#ifndef DOXYGEN_IGNORE
+typedef struct gDiagArena gDiagArena;
+#endif
+
+/**
+ * \struct gDiagBuffer
+ * \brief Growable list of diagnostics plus storage for their strings.
+*/
+typedef struct gDiagBuffer
+{
+   gDiagnostic *list;      //!< Records
+   int         count;      //!< Number of records
+   int         max;        //!< Allocated size of list
+   gDiagArena  *arena;     //!< Storage for string arguments
+   gDiagSink   sink;       //!< Optional callback for new records
+   void        *context;   //!< Stored in every record and passed to sink
+   const gAllocator *allocator; //!< Allocator for the records and strings
+} gDiagBuffer;
+
+
+/**
+ * \fn void gInitDiagnostics(gDiagBuffer *buffer)
+ * \brief Initializes an empty diagnostics buffer.
+ *
+ * The buffer uses the global allocator. Set buffer->allocator right after 
+ * this call to use another one.
+*/
+void gInitDiagnostics(gDiagBuffer *buffer);
+
+
+/**
+ * \fn void gFreeDiagnostics(gDiagBuffer *buffer)
+ * \brief Frees all memory held by a diagnostics buffer.
+ *
+ * The buffer itself isn't freed and can be reused after gInitDiagnostics.
+*/
+void gFreeDiagnostics(gDiagBuffer *buffer);
+
+
+/**
+ * \fn void gClearDiagnostics(gDiagBuffer *buffer)
+ * \brief Removes all records, keeping the sink and context.
+*/
+void gClearDiagnostics(gDiagBuffer *buffer);
+
+
+/**
+ * \fn void gSetDiagnosticSink(gDiagBuffer *buffer, gDiagSink sink, void *context)
+ * \brief Sets the callback and context pointer of a diagnostics buffer.
+ *
+ * @param[in] buffer Buffer to change.
+ * @param[in] sink Function called for each new record, may be NULL.
+ * @param[in] context Pointer stored in each new record and passed to sink.
+*/
+void gSetDiagnosticSink(gDiagBuffer *buffer, gDiagSink sink, void *context);
+
+
+/**
+ * \fn const gDiagnostic *gAddDiagnostic(gDiagBuffer *buffer, int code, int severity, const char *stream, int linenum, int charnum, const char *sarg0, const char *sarg1, int iarg0, int iarg1)
+ * \brief Adds a record to the buffer.
+ *
+ * The string arguments are copied, stream is not. Calls the sink if one is
+ * set.
+ *
+ * @return The new record, valid until the next record is added.
+*/
+const gDiagnostic *gAddDiagnostic(gDiagBuffer *buffer, int code, int severity, const char *stream, 
+                                  int linenum, int charnum, const char *sarg0, const char *sarg1, 
+                                  int iarg0, int iarg1);
+
+
+/**
+ * \fn int gGetDiagnosticCount(const gDiagBuffer *buffer)
+ * \brief Returns the number of records in the buffer.
+*/
+int gGetDiagnosticCount(const gDiagBuffer *buffer);
+
+
+/**
+ * \fn const gDiagnostic *gGetDiagnostic(const gDiagBuffer *buffer, int index)
+ * \brief Returns a record by index, or NULL if index is out of range.
+ *
+ * The pointer is valid until the next record is added.
+*/
+const gDiagnostic *gGetDiagnostic(const gDiagBuffer *buffer, int index);
+
+
+/**
+ * \fn int gFormatDiagnostic(const gDiagnostic *diag, char *buffer, int size)
+ * \brief Formats a record into text.
+ *
+ * The text is the same as the messages passed to gTokenParms::setError.
+ * The output is always null-terminated and cut to fit in size chars.
+ *
+ * @param[in] diag Record to format.
+ * @param[out] buffer Destination.
+ * @param[in] size Size of buffer in chars.
+ * @return Length of the text written.
+*/
+int gFormatDiagnostic(const gDiagnostic *diag, char *buffer, int size);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
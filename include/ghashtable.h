@@ -40,6 +40,11 @@
  * which archives, and searches objects by a string "key". This can also be 
  * used for memory management: if a free function is given to the table, that
  * function will be called with any item removed from the table.
+ *
+ * The table uses open addressing over flat arrays. Each slot has a control
+ * byte holding a 7 bit tag of the key's hash, and lookups scan groups of 
+ * GHASH_GROUPSIZE control bytes at once (using SSE2 when available). Keys are
+ * only compared for slots whose tag and full stored hash both match.
 */
 
 
@@ -53,6 +58,22 @@ extern "C"
 // Generalized hash table which associates an object with a unique string
 // identifier. 
 
+/** Number of control bytes probed at once. */
+#define GHASH_GROUPSIZE 16
+
+#ifndef DOXYGEN_IGNORE
+typedef struct gHashSlot gHashSlot;
+typedef struct gKeyChunk gKeyChunk;
+#endif
+
+/** Kinds of keys a gHashTable can hold. */
+typedef enum
+{
+   ghStringKeys,     //!< NUL terminated strings, copied by the table
+   ghSpanKeys,       //!< Strings with a length, not copied; must outlive their items
+   ghIntKeys,        //!< Integers up to the size of a pointer
+   ghPointerKeys,    //!< Pointers, compared by address
+} gHashKeys_e;
 
 /**
  * \struct gHashTable
@@ -62,7 +83,16 @@ extern "C"
  * Only one occurance of each key is allowed in the table, and the table can 
  * optionally ignore case. These tables can also optionally be used for memory
  * management of the contents. It is recommended that these tables be created 
- * with gNewHashTable and freed with gFreeHashTable.
+ * with gNewHashTable and freed with gFreeHashTable. 
+ *
+ * The table grows by itself when it passes 7/8 load. Growing is incremental:
+ * new arrays are allocated and every later add or remove moves a couple of
+ * groups of slots over, so no single call pays for moving the whole table.
+ * Until the move is done, lookups check both the new and the old arrays.
+ *
+ * Items live in the slot arrays, and copies of string keys are packed into
+ * an arena of growing chunks, so adding an item doesn't allocate by itself
+ * and freeing the table releases a handful of blocks.
  * \see ghashtable.h::gNewHashTable, ghashtable.h::gFreeHashTable, 
  *      ghashtable.h::gFreeHashTable, ghashtable.h::gAddTableItem, 
  *      ghashtable.h::gFindTableItem, ghashtable.h::gRemoveTableItem,
@@ -70,19 +100,36 @@ extern "C"
 */
 typedef struct gHashTable
 {
-   gList *chains;  //!< List of hash chains in the table.
+   unsigned char *ctrl; //!< Control byte of each slot: hash tag, empty or deleted
+   gHashSlot *slots;    //!< Key, object and hash of each slot
+   unsigned int capacity;   //!< Number of slots, a power of two
+   unsigned int growthLeft; //!< Items that can be added before the table is resized
+
+   unsigned char *oldCtrl;  //!< Control bytes of the arrays being moved out of, or NULL
+   gHashSlot *oldSlots;     //!< Slots being moved out of
+   unsigned int oldCapacity;  //!< Number of slots being moved out of
+   unsigned int migrated;   //!< Old slots moved so far
 
    /** \brief Function called when objects are removed from the table. */
    void (*freeFunc)(void *object);
 
-   /** \brief Function used to hash the strings passed to the table. */
-   unsigned (*hashFunc)(const char *string);
+   /** \brief Function used to hash the keys passed to the table. */
+   unsigned (*hashFunc)(const char *key, unsigned int len);
 
-   /** \brief Function used to compare individual elements in a hash chain. */
-   int (*compFunc)(const char *s1, const char *s2);
+   /** \brief Function used to compare keys of equal length, NULL for integer and pointer keys. */
+   int (*compFunc)(const char *s1, const char *s2, size_t len);
+
+   /** \brief Kind of keys in the table. */
+   gHashKeys_e keyType;
+
+   gKeyChunk *keyChunks;      //!< Arena holding the copies of string keys
+   size_t keyBytes;           //!< Arena bytes used, including removed keys
+   size_t deadKeyBytes;       //!< Arena bytes of removed keys
 
    /** \brief Number of items in the table. */
    unsigned int itemCount;
+   /** \brief Allocator used for the table, its items and keys. */
+   const gAllocator *allocator;
 } gHashTable;
 
 
@@ -92,11 +139,12 @@ typedef struct gHashTable
  * \fn gHashTable *gNewHashTable(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase)
  * \brief Creates a new hash table.
  *
- * Creates a new gHashTable object with the given number of hash chains.
- * If freeFunc is null, the code assumes the objects in the table should 
- * not be freed when they are removed or the table is freed.
+ * Creates a new gHashTable object with room for at least numChains items
+ * (the table used to have chains; the name is kept). If freeFunc is null, 
+ * the code assumes the objects in the table should not be freed when they 
+ * are removed or the table is freed.
  *
- * @param[in] numChains Initian number of chains in the table.
+ * @param[in] numChains Number of items to make room for. Must not be 0.
  * @param[in] freeFunc Function used to free items when they are removed. Can be NULL.
  * @param[in] ignoreCase If true, the hash table will ignore case when storing/finding items.
  * @returns Newly created hash table or NULL on error.
@@ -104,6 +152,57 @@ typedef struct gHashTable
 gHashTable *gNewHashTable(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase);
 
 
+/** 
+ * \fn gHashTable *gNewHashTableEx(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase, const gAllocator *allocator)
+ * \brief Creates a new hash table using the given allocator.
+ *
+ * Same as gNewHashTable, but all memory of the table (including the copies
+ * of the keys) is allocated with allocator instead of the global allocator.
+ *
+ * @param[in] numChains Number of items to make room for. Must not be 0.
+ * @param[in] freeFunc Function used to free items when they are removed. Can be NULL.
+ * @param[in] ignoreCase If true, the hash table will ignore case when storing/finding items.
+ * @param[in] allocator Allocator for the table, NULL for the global allocator.
+ * @returns Newly created hash table or NULL on error.
+*/
+gHashTable *gNewHashTableEx(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase, const gAllocator *allocator);
+
+
+/** 
+ * \fn gHashTable *gNewKeyedHashTable(unsigned numChains, void (*freeFunc)(void *), gHashKeys_e keyType, bool ignoreCase)
+ * \brief Creates a new hash table for the given kind of keys.
+ *
+ * String tables copy their keys. Span tables keep pointers to the keys 
+ * instead, so the keys must stay valid as long as their items are in the 
+ * table. Both work with the string and span functions. Integer and pointer
+ * tables work with the gAddIntItem and gAddPtrItem families of functions.
+ *
+ * @param[in] numChains Number of items to make room for. Must not be 0.
+ * @param[in] freeFunc Function used to free items when they are removed. Can be NULL.
+ * @param[in] keyType Kind of keys the table holds.
+ * @param[in] ignoreCase If true, string and span keys ignore case.
+ * @returns Newly created hash table or NULL on error.
+*/
+gHashTable *gNewKeyedHashTable(unsigned numChains, void (*freeFunc)(void *), gHashKeys_e keyType, bool ignoreCase);
+
+
+/** 
+ * \fn gHashTable *gNewKeyedHashTableEx(unsigned numChains, void (*freeFunc)(void *), gHashKeys_e keyType, bool ignoreCase, const gAllocator *allocator)
+ * \brief Creates a new hash table for the given kind of keys using the given allocator.
+ *
+ * Same as gNewKeyedHashTable, with all memory allocated with allocator.
+ *
+ * @param[in] numChains Number of items to make room for. Must not be 0.
+ * @param[in] freeFunc Function used to free items when they are removed. Can be NULL.
+ * @param[in] keyType Kind of keys the table holds.
+ * @param[in] ignoreCase If true, string and span keys ignore case.
+ * @param[in] allocator Allocator for the table, NULL for the global allocator.
+ * @returns Newly created hash table or NULL on error.
+*/
+gHashTable *gNewKeyedHashTableEx(unsigned numChains, void (*freeFunc)(void *), gHashKeys_e keyType, 
+                                 bool ignoreCase, const gAllocator *allocator);
+
+
 /**
  * \fn void gFreeHashTable(gHashTable *table)
  * \brief Frees a hash table.
@@ -136,7 +235,8 @@ bool gAddTableItem(gHashTable *table, const char *key, void *item);
  * \brief Searches a hash table for an item with a matching key.
  *
  * Searches the hash table for the given key and returns a pointer to the associated
- * item.
+ * item. Lookups don't change the table, so any number of threads can search
+ * a table nobody is changing.
  *
  * @param[in] table Hash table to search
  * @param[in] key Hash key to search for
@@ -159,19 +259,441 @@ void *gFindTableItem(gHashTable *table, const char *key);
 bool gRemoveTableItem(gHashTable *table, const char *key);
 
 
+/**
+ * \fn bool gAddSpanItem(gHashTable *table, const char *key, unsigned int len, void *item)
+ * \brief Adds an item under the first len chars of key.
+ *
+ * Works like gAddTableItem, for keys that aren't NUL terminated, such as 
+ * slices of the source. Span tables don't copy the key.
+ *
+ * @param[in] table String or span table to add the item to.
+ * @param[in] key Start of the key.
+ * @param[in] len Length of the key.
+ * @param[in] item Actual item to be stored.
+ * @returns true on success, false if the item already exists.
+*/
+bool gAddSpanItem(gHashTable *table, const char *key, unsigned int len, void *item);
+
+
+/**
+ * \fn void *gFindSpanItem(gHashTable *table, const char *key, unsigned int len)
+ * \brief Searches a hash table for the first len chars of key.
+ *
+ * @param[in] table String or span table to search.
+ * @param[in] key Start of the key.
+ * @param[in] len Length of the key.
+ * @returns Associated object on success, NULL on fail.
+*/
+void *gFindSpanItem(gHashTable *table, const char *key, unsigned int len);
+
+
+/**
+ * \fn bool gRemoveSpanItem(gHashTable *table, const char *key, unsigned int len)
+ * \brief Removes the item stored under the first len chars of key.
+ *
+ * @param[in] table String or span table to remove the item from.
+ * @param[in] key Start of the key.
+ * @param[in] len Length of the key.
+ * @return True if the item was removed, false if it could not be found.
+*/
+bool gRemoveSpanItem(gHashTable *table, const char *key, unsigned int len);
+
+
+/**
+ * \fn unsigned int gHashSpan(const char *key, unsigned int len, bool ignoreCase)
+ * \brief Hashes a key the way string and span tables do.
+ *
+ * The hash only depends on the chars and ignoreCase, so it can be computed 
+ * once (while lexing, for example) and used with gFindHashedItem on any 
+ * string or span table with the same ignoreCase.
+ *
+ * @param[in] key Start of the key.
+ * @param[in] len Length of the key.
+ * @param[in] ignoreCase Whether the tables the hash is used with ignore case.
+ * @returns Hash of the key.
+*/
+unsigned int gHashSpan(const char *key, unsigned int len, bool ignoreCase);
+
+
+/**
+ * \fn void *gFindHashedItem(gHashTable *table, const char *key, unsigned int len, unsigned int hash)
+ * \brief Searches a hash table with a hash computed earlier.
+ *
+ * Same as gFindSpanItem, but skips hashing the key.
+ *
+ * @param[in] table String or span table to search.
+ * @param[in] key Start of the key.
+ * @param[in] len Length of the key.
+ * @param[in] hash Hash of the key from gHashSpan.
+ * @returns Associated object on success, NULL on fail.
+*/
+void *gFindHashedItem(gHashTable *table, const char *key, unsigned int len, unsigned int hash);
+
+
+/**
+ * \fn bool gAddIntItem(gHashTable *table, size_t key, void *item)
+ * \brief Adds an item to an integer or pointer table.
+ *
+ * @param[in] table Table to add the item to.
+ * @param[in] key Integer key, for example an interned id.
+ * @param[in] item Actual item to be stored.
+ * @returns true on success, false if the item already exists.
+*/
+bool gAddIntItem(gHashTable *table, size_t key, void *item);
+
+
+/**
+ * \fn void *gFindIntItem(gHashTable *table, size_t key)
+ * \brief Searches an integer or pointer table.
+ *
+ * @param[in] table Table to search.
+ * @param[in] key Integer key.
+ * @returns Associated object on success, NULL on fail.
+*/
+void *gFindIntItem(gHashTable *table, size_t key);
+
+
+/**
+ * \fn bool gRemoveIntItem(gHashTable *table, size_t key)
+ * \brief Removes an item from an integer or pointer table.
+ *
+ * @param[in] table Table to remove the item from.
+ * @param[in] key Integer key.
+ * @return True if the item was removed, false if it could not be found.
+*/
+bool gRemoveIntItem(gHashTable *table, size_t key);
+
+
+/**
+ * \fn bool gAddPtrItem(gHashTable *table, const void *key, void *item)
+ * \brief Adds an item to a pointer table.
+ *
+ * @param[in] table Table to add the item to.
+ * @param[in] key Pointer key, compared by address.
+ * @param[in] item Actual item to be stored.
+ * @returns true on success, false if the item already exists.
+*/
+bool gAddPtrItem(gHashTable *table, const void *key, void *item);
+
+
+/**
+ * \fn void *gFindPtrItem(gHashTable *table, const void *key)
+ * \brief Searches a pointer table.
+ *
+ * @param[in] table Table to search.
+ * @param[in] key Pointer key.
+ * @returns Associated object on success, NULL on fail.
+*/
+void *gFindPtrItem(gHashTable *table, const void *key);
+
+
+/**
+ * \fn bool gRemovePtrItem(gHashTable *table, const void *key)
+ * \brief Removes an item from a pointer table.
+ *
+ * @param[in] table Table to remove the item from.
+ * @param[in] key Pointer key.
+ * @return True if the item was removed, false if it could not be found.
+*/
+bool gRemovePtrItem(gHashTable *table, const void *key);
+
+
 /**
  * \fn bool gRehashTable(gHashTable *table, unsigned int numChains)
- * \brief Changes the number of hash chains
+ * \brief Resizes a hash table.
  *
- * Resizes and re-hashes the given table to the specified number of chains.
+ * Resizes and re-hashes the given table to the smallest size that holds
+ * numChains items (or the current items, if there are more) without growing.
+ * This also clears out the slots of removed items, gives back the memory of
+ * their keys, and finishes any resize still in progress.
  *
  * @param[in] table Hash table to be rehashed
- * @param[in] numChains Number of chains the table should have.
+ * @param[in] numChains Number of items the table should have room for.
  * @returns true on success, false on error.
 */
 bool gRehashTable(gHashTable *table, unsigned int numChains);
 
 
+/**
+ * \fn void gFinishTableResize(gHashTable *table)
+ * \brief Finishes moving items after a resize.
+ *
+ * Growing a table moves its items into the new slots a few at a time on 
+ * later adds and removes, and lookups check both sets of slots until it's 
+ * done. A table that stops changing mid-move keeps both. Call this after 
+ * building a table that will only be read from then on. Lookups never move
+ * items themselves, so that several threads can read an unchanged table.
+ *
+ * @param[in] table Hash table to finish.
+*/
+void gFinishTableResize(gHashTable *table);
+
+
+
+// ----------------------------------------------------------------------------
+// gSharedHashTable
+// Read-mostly hash table shared between threads.
+
+/**
+ * \struct gSharedHashTable
+ * \brief Hash table with lock-free lookups, for sharing between threads.
+ *
+ * Meant for string keyed tables that are filled once and then read by many
+ * threads, like keyword or label tables. Lookups never lock or write to the table. 
+ * Changes are copy-on-write: the writer builds a changed copy of the table 
+ * under a lock and publishes it, so every change costs a copy of the whole
+ * table. Reader threads register with gAddSharedReader and wrap their 
+ * searches in gEnterShared and gLeaveShared. Replaced copies and removed 
+ * objects are freed once every reader that could reach them has left.
+ * \see ghashtable.h::gShareHashTable, ghashtable.h::gFindSharedItem
+*/
+#ifndef DOXYGEN_IGNORE
+typedef struct gSharedHashTable gSharedHashTable;
+#endif
+
+
+/**
+ * \struct gSharedReader
+ * \brief Registration of one reader thread of a gSharedHashTable.
+ *
+ * Each reader thread needs its own. Records the epoch the thread entered 
+ * the table in, so the writers know which copies it may still be using.
+ * \see ghashtable.h::gAddSharedReader, ghashtable.h::gEnterShared
+*/
+#ifndef DOXYGEN_IGNORE
+typedef struct gSharedReader gSharedReader;
+#endif
+
+
+/**
+ * \fn gSharedHashTable *gShareHashTable(gHashTable *table)
+ * \brief Turns a hash table into a shared table.
+ *
+ * The shared table takes over table, including freeing its objects with
+ * the table's freeFunc. table must not be used directly afterwards.
+ *
+ * @param[in] table Filled hash table to share.
+ * @returns New shared table, or NULL if table is NULL.
+*/
+gSharedHashTable *gShareHashTable(gHashTable *table);
+
+
+/**
+ * \fn void gFreeSharedHashTable(gSharedHashTable *shared)
+ * \brief Frees a shared table.
+ *
+ * Frees the table, all replaced copies, all objects and all readers that
+ * are still registered. No other thread may be using the table.
+ *
+ * @param[in] shared Shared table to free.
+*/
+void gFreeSharedHashTable(gSharedHashTable *shared);
+
+
+/**
+ * \fn void *gFindSharedItem(gSharedHashTable *shared, const char *key)
+ * \brief Searches a shared table without locking.
+ *
+ * Can be called from any thread, at the same time as changes, between 
+ * gEnterShared and gLeaveShared. The object found stays valid until 
+ * gLeaveShared, even if it's removed in the meantime. If no reader is ever
+ * registered, searches must not overlap gReclaimSharedTable instead.
+ *
+ * @param[in] shared Shared table to search.
+ * @param[in] key Key to search for.
+ * @returns Associated object on success, NULL on fail.
+*/
+void *gFindSharedItem(gSharedHashTable *shared, const char *key);
+
+
+/**
+ * \fn bool gAddSharedItem(gSharedHashTable *shared, const char *key, void *item)
+ * \brief Adds an item to a shared table.
+ *
+ * Publishes a copy of the table with the item added. Threads already 
+ * searching keep using the previous copy. Copies no active reader can 
+ * reach are freed right away if any reader is registered.
+ *
+ * @param[in] shared Shared table to add the item to.
+ * @param[in] key String key to associate with the item, will be copied.
+ * @param[in] item Item to store.
+ * @returns true on success, false if the key already exists.
+*/
+bool gAddSharedItem(gSharedHashTable *shared, const char *key, void *item);
+
+
+/**
+ * \fn bool gRemoveSharedItem(gSharedHashTable *shared, const char *key)
+ * \brief Removes an item from a shared table.
+ *
+ * Publishes a copy of the table without the item. The object is freed 
+ * once every reader that could have found it has left the table.
+ *
+ * @param[in] shared Shared table to remove the item from.
+ * @param[in] key Key of the item to remove.
+ * @returns true if the item was removed, false if it could not be found.
+*/
+bool gRemoveSharedItem(gSharedHashTable *shared, const char *key);
+
+
+/**
+ * \fn void gReclaimSharedTable(gSharedHashTable *shared)
+ * \brief Frees replaced copies and removed objects of a shared table.
+ *
+ * Frees only what was replaced or removed before the oldest active reader
+ * entered, so it can be called at any time. Changes do the same on their 
+ * own once a reader is registered; this is for tables without readers or
+ * to free memory as soon as the last reader leaves.
+ *
+ * @param[in] shared Shared table to reclaim memory of.
+*/
+void gReclaimSharedTable(gSharedHashTable *shared);
+
+
+/**
+ * \fn gSharedReader *gAddSharedReader(gSharedHashTable *shared)
+ * \brief Registers a reader thread with a shared table.
+ *
+ * Call once per thread, before its first search.
+ *
+ * @param[in] shared Shared table the thread will search.
+ * @returns New reader, or NULL if shared is NULL.
+*/
+gSharedReader *gAddSharedReader(gSharedHashTable *shared);
+
+
+/**
+ * \fn void gRemoveSharedReader(gSharedReader *reader)
+ * \brief Unregisters and frees a reader.
+ *
+ * The reader must not be between gEnterShared and gLeaveShared.
+ *
+ * @param[in] reader Reader to remove.
+*/
+void gRemoveSharedReader(gSharedReader *reader);
+
+
+/**
+ * \fn void gEnterShared(gSharedReader *reader)
+ * \brief Marks the start of a reader's searches.
+ *
+ * Copies and objects the reader can reach are kept until gLeaveShared. 
+ * Calls don't nest, and the reader should leave regularly, for example 
+ * after every token or line, or memory builds up.
+ *
+ * @param[in] reader Reader of the calling thread.
+*/
+void gEnterShared(gSharedReader *reader);
+
+
+/**
+ * \fn void gLeaveShared(gSharedReader *reader)
+ * \brief Marks the end of a reader's searches.
+ *
+ * Objects found since gEnterShared may be freed afterwards.
+ *
+ * @param[in] reader Reader of the calling thread.
+*/
+void gLeaveShared(gSharedReader *reader);
+
+
+
+// ----------------------------------------------------------------------------
+// gStaticHashTable
+// Immutable hash table built in one go.
+
+/**
+ * \struct gStaticHashTable
+ * \brief Immutable string keyed table with a minimal perfect hash.
+ *
+ * For tables that are built once and then only read, like keyword, label 
+ * and enum name maps. The table is built from all keys at once into a 
+ * single block holding exactly one slot per key and copies of the keys. A 
+ * lookup hashes the key once, reads one slot and compares one key. The 
+ * table doesn't own its values. Lookups don't change the table, so it can be
+ * read by any number of threads.
+ * \see ghashtable.h::gBuildStaticHashTable, ghashtable.h::gFindStaticItem
+*/
+#ifndef DOXYGEN_IGNORE
+typedef struct gStaticHashTable gStaticHashTable;
+#endif
+
+
+/**
+ * \fn gStaticHashTable *gBuildStaticHashTable(const char **keys, void **values, unsigned int n)
+ * \brief Builds a case sensitive static hash table.
+ *
+ * Builds a table mapping keys[i] to values[i]. If a key occurs more than 
+ * once, the first occurance is kept.
+ *
+ * @param[in] keys Keys of the table, copied into the table.
+ * @param[in] values Value of each key. Must not be NULL.
+ * @param[in] n Number of keys.
+ * @returns New table, or NULL on error.
+*/
+gStaticHashTable *gBuildStaticHashTable(const char **keys, void **values, unsigned int n);
+
+
+/**
+ * \fn gStaticHashTable *gBuildStaticHashTableEx(const char **keys, void **values, unsigned int n, bool ignoreCase, const gAllocator *allocator)
+ * \brief Builds a static hash table with options.
+ *
+ * Same as gBuildStaticHashTable, optionally ignoring case, with the table 
+ * allocated with allocator.
+ *
+ * @param[in] keys Keys of the table, copied into the table.
+ * @param[in] values Value of each key. Must not be NULL.
+ * @param[in] n Number of keys.
+ * @param[in] ignoreCase If true, keys are matched ignoring case.
+ * @param[in] allocator Allocator for the table, NULL for the global allocator.
+ * @returns New table, or NULL on error.
+*/
+gStaticHashTable *gBuildStaticHashTableEx(const char **keys, void **values, unsigned int n, 
+                                          bool ignoreCase, const gAllocator *allocator);
+
+
+/**
+ * \fn void gFreeStaticHashTable(gStaticHashTable *table)
+ * \brief Frees a static hash table. The values are not freed.
+ *
+ * @param[in] table Table to free.
+*/
+void gFreeStaticHashTable(gStaticHashTable *table);
+
+
+/**
+ * \fn unsigned int gGetStaticTableSize(gStaticHashTable *table)
+ * \brief Returns the number of distinct keys in a static hash table.
+ *
+ * @param[in] table Table to get the size of.
+ * @returns Number of keys.
+*/
+unsigned int gGetStaticTableSize(gStaticHashTable *table);
+
+
+/**
+ * \fn void *gFindStaticItem(gStaticHashTable *table, const char *key)
+ * \brief Searches a static hash table.
+ *
+ * @param[in] table Table to search.
+ * @param[in] key Key to search for.
+ * @returns Value of the key, NULL if it is not in the table.
+*/
+void *gFindStaticItem(gStaticHashTable *table, const char *key);
+
+
+/**
+ * \fn void *gFindStaticSpanItem(gStaticHashTable *table, const char *key, unsigned int len)
+ * \brief Searches a static hash table for the first len chars of key.
+ *
+ * @param[in] table Table to search.
+ * @param[in] key Start of the key.
+ * @param[in] len Length of the key.
+ * @returns Value of the key, NULL if it is not in the table.
+*/
+void *gFindStaticSpanItem(gStaticHashTable *table, const char *key, unsigned int len);
+
+
 
 #ifdef __cplusplus
 }
@@ -46,17 +46,27 @@ extern "C"
 #endif
 
 #include "gbool.h"
+#include "galloc.h"
 
 // ----------------------------------------------------------------------------
 // gList
 // Resizable array of object pointers. 
 
+/** Number of items a list holds inside its struct before it allocates. */
+#define GLIST_SMALLSIZE 8
+
 
 /**
  * \struct gList
  * \brief Structure which holds the list and all related data.
  *
- * Structure which holds the list and all related data.
+ * Structure which holds the list and all related data. Short lists keep 
+ * their items in the small buffer inside the struct, so a gList must not be
+ * copied by value.
+ *
+ * Removing items from the front (gPopListFront, or gDeleteListRange and
+ * gDeleteListItem starting at 0) takes constant time, and gPushListFront
+ * is amortized constant time, so a list also works as a queue or deque.
  *
  * \see  glist.h::gNewList, glist.h::gInitList, glist.h::gFreeList,
  *       glist.h::gClearList, glist.h::gAppendListItem,
@@ -68,11 +78,15 @@ extern "C"
 typedef struct
 {
    void     **list; //!< List of pointers to items
-   unsigned max;    //!< Total number of pointers allocated
+   void     **base; //!< Start of the storage; list is past it after removals from the front
+   unsigned max;    //!< Total number of pointers allocated from base
    unsigned size;   //!< Total number of items in the list (occupied pointers)
 
    void     (*freeFunc)(void *); //!< Function called with an item is removed.
    bool     freestruct;          //!< If true, gFreeList will free this struct.
+   const gAllocator *allocator;  //!< Allocator used for the list memory.
+
+   void     *small[GLIST_SMALLSIZE]; //!< Storage used while the list is short.
 } gList;
 
 
@@ -91,6 +105,20 @@ typedef struct
 gList *gNewList(void (*freeFunc)(void *));
 
 
+/**
+ * \fn gList *gNewListEx(void (*freeFunc)(void *), const gAllocator *allocator)
+ * \brief Allocates and inits new gList object using the given allocator.
+ *
+ * Same as gNewList, but the list struct and array are allocated with 
+ * allocator instead of the global allocator.
+ *
+ * @param[in] freeFunc Function caled when an item is removed from the list. Can be NULL.
+ * @param[in] allocator Allocator for the list, NULL for the global allocator.
+ * @returns Newly allocated gList object.
+*/
+gList *gNewListEx(void (*freeFunc)(void *), const gAllocator *allocator);
+
+
 /**
  * \fn void gInitList(gList *list, void (*freeFunc)(void *))
  * \brief Initializes a gList
@@ -220,7 +248,8 @@ void gDeleteListItem(gList *l, unsigned int index);
  *
  * Deletes a series of items from the list. The indices are clipped to the
  * actual dimensions of the list. If first is greater than last, or if first is
- * out of bounds, the function aborts.
+ * out of bounds, the function aborts. Ranges starting at 0 are removed 
+ * without moving the remaining items.
  *
  * @param[in] l List to remove the items from
  * @param[in] first Index of the first item to remove
@@ -234,8 +263,9 @@ void gDeleteListRange(gList *l, unsigned int first, unsigned int last);
  * \brief Trims unused memory.
  *
  * This function will reallocate the internal pointer list of the given list
- * object to the current list size. This is useful if the list got really big
- * and doesn't need to be that big any more.
+ * object to the current list size, going back to the small buffer if the 
+ * items fit. This is useful if the list got really big and doesn't need to 
+ * be that big any more.
  *
  * @param[in] l List to trim
 */
@@ -259,6 +289,89 @@ void gTrimUnusedList(gList *l);
 bool gMoveListItems(gList *src, unsigned int srcindex, gList *dest, unsigned int count);
 
 
+/**
+ * \fn void gReserveList(gList *l, unsigned int count)
+ * \brief Makes room for items in a list.
+ *
+ * Grows the list storage so it holds at least count items without 
+ * reallocating. Use gTrimUnusedList to give the room back.
+ *
+ * @param[in] l List to make room in
+ * @param[in] count Number of items the list should have room for
+*/
+void gReserveList(gList *l, unsigned int count);
+
+
+/**
+ * \fn void gInsertListItems(gList *l, unsigned int toindex, void **objects, unsigned int count)
+ * \brief Inserts several items into a list.
+ *
+ * Inserts count objects into the list at toindex in one move, shifting the 
+ * items >= toindex up. toindex is clipped to the size of the list. 
+ *
+ * @param[in] l List to add the items to
+ * @param[in] toindex Index to place the first item at (0 to l->size)
+ * @param[in] objects Items to be added
+ * @param[in] count Number of items to add
+*/
+void gInsertListItems(gList *l, unsigned int toindex, void **objects, unsigned int count);
+
+
+/**
+ * \fn void gSwapDeleteListItem(gList *l, unsigned int index)
+ * \brief Removes an item from a list, moving the last item into its place.
+ *
+ * Same as gDeleteListItem without shifting the rest of the list, for lists
+ * where order doesn't matter.
+ *
+ * @param[in] l List to remove the item from
+ * @param[in] index Index of the item to remove
+*/
+void gSwapDeleteListItem(gList *l, unsigned int index);
+
+
+/**
+ * \fn bool gSpliceList(gList *dest, unsigned int destindex, gList *src, unsigned int srcindex, unsigned int count)
+ * \brief Moves a range of items from one list into another.
+ *
+ * Moves count items starting at srcindex out of src and inserts them into 
+ * dest at destindex. The items are not freed. src and dest must be 
+ * different lists.
+ *
+ * @param[out] dest List to move items to
+ * @param[in] destindex Index in dest to insert the items at, clipped to its size
+ * @param[in] src List to move items from
+ * @param[in] srcindex Index of the first item to move
+ * @param[in] count Number of items to move
+ * @returns true on success, false on error.
+*/
+bool gSpliceList(gList *dest, unsigned int destindex, gList *src, unsigned int srcindex, unsigned int count);
+
+
+/**
+ * \fn void *gPopListFront(gList *l)
+ * \brief Removes and returns the first item of a list.
+ *
+ * Takes constant time. The item is not freed.
+ *
+ * @param[in] l List to take the item from
+ * @returns The first item, or NULL if the list is empty.
+*/
+void *gPopListFront(gList *l);
+
+
+/**
+ * \fn void gPushListFront(gList *l, void *object)
+ * \brief Adds an item to the front of a list.
+ *
+ * Same as gInsertListItem at index 0, in amortized constant time.
+ *
+ * @param[in] l List to add the item to
+ * @param[in] object Item to be added to the list.
+*/
+void gPushListFront(gList *l, void *object);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -37,8 +37,12 @@ extern "C"
 {
 #endif
 
+#include "galloc.h"
 #include "gtokenize.h"
 #include "gtpattern.h"
+#include "gtokencache.h"
+#include "gpipeline.h"
+#include "gparsefiles.h"
 
 
 #endif
\ No newline at end of file
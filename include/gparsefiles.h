@@ -0,0 +1,129 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef GPARSEFILES_H
+#define GPARSEFILES_H
+
+/**
+ * \file gparsefiles.h
+ * \brief Parsing many files in parallel.
+ *
+ * gParseFiles runs one pattern over each file of a list on a pool of worker
+ * threads. Each file gets its own gTextStream, gTokenStream and tPattern, 
+ * created and freed on the worker that parses it. 
+ *
+ * What can be shared between threads:
+ *    - gCompiledParms: read only once compiled, one object serves all 
+ *      workers (gTokenParms must not be changed while they run).
+ *    - tpStep lists: read only, each pattern builds its own label table.
+ *    - Everything else (text streams, token streams, tokens, patterns, lists,
+ *      stacks, hash tables, diagnostics buffers) belongs to one thread.
+ *
+ * Hooks and the setError function of the parameters are called on the
+ * worker threads and must be thread safe. Prefer the merged diagnostics 
+ * over setError, they come back in a fixed order.
+*/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "gtokenize.h"
+#include "gtpattern.h"
+
+
+/**
+ * \struct gParseHooks
+ * \brief Optional callbacks made by gParseFiles for each file.
+ *
+ * Both are called on the worker thread parsing the file. begin can set
+ * tPattern::userdata to give the step hooks per file state.
+*/
+typedef struct gParseHooks
+{
+   /** Called before the pattern is executed (ignored if NULL). */
+   void  (*begin)(tPattern *p, int index, void *context);
+
+   /** Called after the pattern is executed, before it is freed (ignored if NULL). */
+   void  (*end)(tPattern *p, int index, int result, void *context);
+
+   void  *context; //!< Passed to both hooks
+} gParseHooks;
+
+
+/**
+ * \struct gParseResult
+ * \brief Outcome of parsing one file with gParseFiles.
+*/
+typedef struct gParseResult
+{
+   int   result;     //!< Return value of tpExecutePattern, tpFatal if the file couldn't be opened
+   int   ecount;     //!< Error count of the pattern
+   int   wcount;     //!< Warning count of the pattern
+   int   firstdiag;  //!< Index of the file's first record in the merged diagnostics
+   int   ndiags;     //!< Number of records the file has there
+} gParseResult;
+
+
+/**
+ * \fn int gParseFiles(const char **paths, int count, const gCompiledParms *cparms, tpStep *stepList, const gParseHooks *hooks, int nthreads, gParseResult *results, gDiagBuffer *diagnostics)
+ * \brief Parses a list of files on a pool of threads.
+ *
+ * Files are started largest first and spread over the workers, which steal
+ * files from each other when they run out. Each worker allocates from its
+ * own arena, which is emptied after every file, so workers never contend 
+ * on the heap for tokens.
+ *
+ * The results and diagnostics are merged in the order of \a paths no
+ * matter which worker parsed which file, so the output is the same for any
+ * number of threads. Diagnostics name the file by the string in \a paths.
+ *
+ * @param[in] paths Files to parse.
+ * @param[in] count Number of files.
+ * @param[in] cparms Tokenizer parameters shared by all files.
+ * @param[in] stepList Pattern run over each file.
+ * @param[in] hooks Per file callbacks, may be NULL.
+ * @param[in] nthreads Number of worker threads, 0 for one per processor.
+ * @param[out] results Array of count results, may be NULL.
+ * @param[out] diagnostics Buffer the diagnostics of all files are added to,
+ *                         may be NULL.
+ * @return The highest result of all files.
+*/
+int gParseFiles(const char **paths, int count, const gCompiledParms *cparms, tpStep *stepList, 
+                const gParseHooks *hooks, int nthreads, gParseResult *results, gDiagBuffer *diagnostics);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
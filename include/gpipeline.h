@@ -0,0 +1,90 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef GPIPELINE_H
+#define GPIPELINE_H
+
+/**
+ * \file gpipeline.h
+ * \brief Lexing on a separate thread.
+ *
+ * A pipelined token stream runs its token source on a dedicated lexer 
+ * thread. The lexer thread reads ahead and publishes tokens into a bounded 
+ * lock-free single-producer/single-consumer queue, and the thread calling 
+ * gGetToken, gGetNextToken or tpExecutePattern takes them from the queue. 
+ * Lexing and pattern execution then overlap instead of running one after the
+ * other.
+ *
+ * Only the consumer thread may use the token stream. The text stream belongs
+ * to the lexer thread while the pipeline runs and must not be touched. 
+ * Diagnostics from the lexer are passed through the queue and reported on 
+ * the consumer thread, in order, so setError is never called from the lexer 
+ * thread.
+*/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "gtokenize.h"
+
+
+/** Queue size used when gStartTokenPipeline is given 0. */
+#define GPIPELINE_DEFAULTSIZE 1024
+
+
+/**
+ * \fn bool gStartTokenPipeline(gTokenStream *tokstrm, int queuesize)
+ * \brief Moves the token source of a stream onto a lexer thread.
+ *
+ * Replaces the source of the token stream with a queue fed by a lexer 
+ * thread running the old source. Tokens come out exactly as they would have
+ * without the pipeline, starting at the current position of the stream. 
+ * The lexer thread is started when the first token is requested and is 
+ * stopped by gResetTokenStream and gFreeTokenStream. Evicted tokens can 
+ * still be re-read with gGetToken if the old source supports it. If the 
+ * thread can't be created, the old source is run on the calling thread 
+ * instead and the stream works as if it had never been pipelined.
+ *
+ * @param[in] tokstrm Token stream to pipeline.
+ * @param[in] queuesize Number of tokens the lexer may read ahead, rounded up
+ *                      to a power of two. 0 uses GPIPELINE_DEFAULTSIZE.
+ * @return true on success, false if the pipeline couldn't be set up.
+*/
+bool gStartTokenPipeline(gTokenStream *tokstrm, int queuesize);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
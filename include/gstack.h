@@ -36,7 +36,7 @@
  * \brief Generalized stack object.
  *
  * gStack provides generalized stack management facilities. The stack 
- * essentially a single linked list where only the "top" entry is immideiately
+ * is essentially an array where only the "top" entry is immideiately
  * available. Entries can be "pushed" on top of the stack, and the top entry 
  * can be "popped" off (removed) exposing the entry directly under it.
 */
@@ -46,26 +46,15 @@ extern "C"
 #endif
 
 #include "gbool.h"
+#include "galloc.h"
 
 // ----------------------------------------------------------------------------
 // gStack
 // Generalized stack container object.
 
 
-#ifndef DOXYGEN_IGNORE
-typedef struct gStackEntry gStackEntry;
-#endif
-
-/**
- * \struct gStackEntry
- * \brief Used by gStack to store an entry and a back-link.
-*/
-typedef struct gStackEntry
-{
-   void        *entry; //!< Object in this entry
-   gStackEntry *prev;  //!< Previous stack entry
-};
-
+/** Number of entries a stack allocates room for on the first push. */
+#define GSTACK_MINSIZE 16
 
 /**
  * \struct gStack
@@ -75,17 +64,29 @@ typedef struct gStackEntry
  * be used for memory management. The member freeFunc is called whenever the
  * top entry is poped from the stack.
  *
+ * Entries are kept in one array that doubles as needed, so pushing and 
+ * popping don't allocate once the stack has been deep enough. Stacks made by
+ * gNewStack hold object pointers. Stacks made by gNewInlineStack hold 
+ * fixed-size entries in the array itself; for those, gGetStackTop and 
+ * gPopStack return pointers into the array, which are valid until the next
+ * push.
+ *
  * \see  gstack.h::gNewStack, gstack.h::gInitStack, gstack.h::gFreeStack,
  *       gstack.h::gClearStack, gstack.h::gPushEntry, gstack::gGetStackTop,
- *       gstack.h::gGetStackSize, gstack.h::gPopStack
+ *       gstack.h::gGetStackSize, gstack.h::gPopStack, 
+ *       gstack.h::gNewInlineStack, gstack.h::gPushInlineEntry
 */
 typedef struct
 {
-   gStackEntry *top;    //!< Top entry in the stack.
-   gStackEntry *unused; //!< Empty/unused entries kept to reduce the number of malloc calls.
+   char         *entries;   //!< Entry array.
+   unsigned int entrysize;  //!< Bytes per entry.
+   unsigned int size;       //!< Number of entries in the stack.
+   unsigned int max;        //!< Number of entries allocated.
+   bool         inlineEntries; //!< If true, entries are stored in place instead of as pointers.
 
    void     (*freeFunc)(void *); //!< Used to free an entry when the stack is poped.
    bool     freestruct; //!< If set to true, gFreeStack will free this struct.
+   const gAllocator *allocator; //!< Allocator used for the stack memory.
 } gStack;
 
 
@@ -103,12 +104,53 @@ typedef struct
 gStack *gNewStack(void (*freeFunc)(void *));
 
 
+/**
+ * \fn gStack *gNewStackEx(void (*freeFunc)(void *), const gAllocator *allocator)
+ * \brief Allocates a new gStack using the given allocator.
+ *
+ * Same as gNewStack, but the stack and its entries are allocated with 
+ * allocator instead of the global allocator.
+ *
+ * @param freeFunc Function called on the top element when the stack is poped.
+ * @param allocator Allocator for the stack, NULL for the global allocator.
+*/
+gStack *gNewStackEx(void (*freeFunc)(void *), const gAllocator *allocator);
+
+
+/**
+ * \fn gStack *gNewInlineStack(unsigned int entrysize, void (*freeFunc)(void *))
+ * \brief Allocates a new gStack which stores its entries in place.
+ *
+ * Each entry is entrysize bytes inside the stack's array, so pushing an 
+ * entry doesn't allocate it separately. freeFunc is called with a pointer
+ * to the entry when it is poped; it should only release what the entry 
+ * refers to. If freeFunc is NULL, a NOP function is used.
+ *
+ * @param entrysize Size of each entry in bytes.
+ * @param freeFunc Function called on the top entry when the stack is poped.
+*/
+gStack *gNewInlineStack(unsigned int entrysize, void (*freeFunc)(void *));
+
+
+/**
+ * \fn gStack *gNewInlineStackEx(unsigned int entrysize, void (*freeFunc)(void *), const gAllocator *allocator)
+ * \brief Allocates a new inline gStack using the given allocator.
+ *
+ * Same as gNewInlineStack, with the stack allocated with allocator.
+ *
+ * @param entrysize Size of each entry in bytes.
+ * @param freeFunc Function called on the top entry when the stack is poped.
+ * @param allocator Allocator for the stack, NULL for the global allocator.
+*/
+gStack *gNewInlineStackEx(unsigned int entrysize, void (*freeFunc)(void *), const gAllocator *allocator);
+
+
 /**
  * \fn void gInitStack(gStack *stack, void (*freeFunc)(void *))
  * \brief Initializes a stack object.
  *
- * Initializes the given stack object. This is called by gNewStack on a newly
- * allocated stack structure.
+ * Initializes the given stack object as a pointer stack. This is called by
+ * gNewStack on a newly allocated stack structure.
 */
 void gInitStack(gStack *stack, void (*freeFunc)(void *));
 
@@ -140,7 +182,8 @@ void gClearStack(gStack *s);
  * \fn void gPushEntry(gStack *s, void *object)
  * \brief Pushes a new entry on top of a gStack
  *
- * Pushes the an entry on top of a gStack.
+ * Pushes the an entry on top of a gStack. Inline stacks copy the entry 
+ * object points to.
  *
  * @param[in] s Stack to push to
  * @param[in] object Object to push on top of the stack
@@ -148,6 +191,31 @@ void gClearStack(gStack *s);
 void gPushEntry(gStack *s, void *object);
 
 
+/**
+ * \fn void *gPushInlineEntry(gStack *s)
+ * \brief Pushes a new entry on top of an inline gStack.
+ *
+ * Adds an entry and returns it to be filled in. The entry is not 
+ * initialized.
+ *
+ * @param[in] s Inline stack to push to
+ * @return The new top entry, or NULL if s is not an inline stack.
+*/
+void *gPushInlineEntry(gStack *s);
+
+
+/**
+ * \fn void gReserveStack(gStack *s, unsigned int count)
+ * \brief Makes room for entries in a stack.
+ *
+ * Grows the entry array so count entries fit without reallocating.
+ *
+ * @param[in] s Stack to make room in
+ * @param[in] count Number of entries to make room for
+*/
+void gReserveStack(gStack *s, unsigned int count);
+
+
 /**
  * \fn void *gGetStackTop(gStack *s)
  * \brief Get the top entry from a stack.
@@ -164,7 +232,7 @@ void *gGetStackTop(gStack *s);
  * \fn int gGetStackSize(gStack *s)
  * \brief Counts entries in a stack.
  *
- * Polls the stack and returns the number of entries in the stack.
+ * Returns the number of entries in the stack.
  *
  * @param[in] s Stack to poll
  * @return Number of entries in the stack.
@@ -177,7 +245,8 @@ int gGetStackSize(gStack *s);
  * \brief Pops the stack.
  *
  * Removes the top of the stack and returns the new top item (returns NULL if
- * the stack is empty). s->freeFunc is called on the old top item.
+ * the stack is empty, including when the last entry was poped). s->freeFunc
+ * is called on the old top item.
  *
  * @param[in] s Stack to pop
  * @return New top entry or NULL if stack is empty.
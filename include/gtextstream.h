@@ -44,6 +44,8 @@ extern "C"
 {
 #endif
 
+#include "galloc.h"
+
 
 // ----------------------------------------------------------------------------
 // Text stream
@@ -61,7 +63,8 @@ extern "C"
  * \see  gtextstream.h::gStreamFromMemory, gtextstream.h::gStreamFromFilename,
  *       gtextstream.h::gFreeStream, gtextstream.h::gGetChar,
  *       gtextstream.h::gReadChar, gtextstream.h::gReadahead,
- *       gtextstream.h::gSeekPos, gtextstream.h::gSeek,
+ *       gtextstream.h::gReadSpan,
+ *       gtextstream.h::gSeekPos, gtextstream.h::gTellPos, gtextstream.h::gSeek,
  *       gtextstream.h::gStreamEnd
 */
 typedef struct gTextStream
@@ -77,8 +80,12 @@ typedef struct gTextStream
    char           (*ggetchar)(struct gTextStream *);
    char           (*readchar)(struct gTextStream *);
    char*          (*readahead)(struct gTextStream *, unsigned int);
+   const char*    (*readspan)(struct gTextStream *, unsigned int *);
    void           (*seek)(struct gTextStream *, int);
    void           (*freestream)(struct gTextStream *);
+
+   // Allocator the stream was created with
+   const gAllocator *allocator;
 #endif
 } gTextStream;
 
@@ -93,7 +100,8 @@ typedef struct gTextStream
  *
  * @param[in] memory The memory buffer to stream from
  * @param[in] length Length of the memory buffer.
- * @param[in] owner If set to true, gFreeStream will free the memory buffer.
+ * @param[in] owner If set to true, gFreeStream will free the memory buffer
+ *                  with the global allocator (see galloc.h).
  * @returns New gTextStream, NULL on failure
 */
 gTextStream *gStreamFromMemory(char *memory, int length, bool owner);
@@ -153,11 +161,26 @@ gTextStream *gStreamFromFilename(const char *filename);
 #define gReadahead(txtstrm, count) txtstrm->readahead(txtstrm, count)
 
 
+/**
+ * \def gReadSpan(txtstrm, lengthptr)
+ * \brief Gets the buffered text at the stream pointer.
+ *
+ * Returns a pointer to the run of characters starting at the stream pointer
+ * which is available without copying, and stores its length in the unsigned
+ * int pointed to by \a lengthptr. Memory streams return the rest of the buffer,
+ * file streams return a chunk of their read buffer. The span is not 
+ * NULL-terminated and is only valid until the next operation on the stream.
+ * Does not increment the stream pointer. Returns NULL on EOF.
+*/
+#define gReadSpan(txtstrm, lengthptr) txtstrm->readspan(txtstrm, lengthptr)
+
+
 /**
  * \fn void gSeekPos(gTextStream *stream, int pos)
  * \brief Seek to a position in the stream.
  *
- * Seeks an absolute position within the stream.
+ * Seeks an absolute position within the stream. Positions are clamped to
+ * the range [0, length], where length is the end of the stream.
  *
  * @param[in] stream Stream to seek within
  * @param[in] pos Position within the stream.
@@ -165,6 +188,19 @@ gTextStream *gStreamFromFilename(const char *filename);
 void gSeekPos(gTextStream *txtstrm, int pos);
 
 
+/**
+ * \fn int gTellPos(gTextStream *stream)
+ * \brief Returns the current position in the stream.
+ *
+ * Returns the absolute position of the next character to be read, which can
+ * be passed to gSeekPos later to return to it.
+ *
+ * @param[in] stream Stream to get the position of.
+ * @returns Position within the stream.
+*/
+int gTellPos(gTextStream *txtstrm);
+
+
 /**
  * \def gSeek(stream, offset)
  * \brief Seek ahead or behind in a stream.
@@ -0,0 +1,177 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+#ifndef GTOKENCACHE_H
+#define GTOKENCACHE_H
+
+/**
+ * \file gtokencache.h
+ * \brief On-disk token cache.
+ *
+ * The token cache stores the tokens of a file in a binary file (the source
+ * path with ".gtok" appended) next to it. The cache records a hash of the 
+ * source text and a fingerprint of the tokenizer parameters. As long as both
+ * still match, the tokens are served straight from the mapped cache file and
+ * the source is never lexed. Otherwise the file is lexed and the cache is
+ * rewritten.
+ *
+ * Cache files use the native byte order and are rejected (and rebuilt) on a
+ * machine with a different one.
+*/
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "gtokenize.h"
+
+
+/**
+ * \typedef gHash64
+ * \brief 64 bit hash value used for content hashes and parms fingerprints.
+*/
+typedef guint64 gHash64;
+
+
+/**
+ * \def GTOKCACHE_EXT
+ * \brief Extension appended to the source path to get the cache path.
+*/
+#define GTOKCACHE_EXT ".gtok"
+
+/**
+ * \def GTOKCACHE_VERSION
+ * \brief Version of the cache file format. Bumped on any layout change.
+*/
+#define GTOKCACHE_VERSION 2
+
+
+/**
+ * \struct gTokCacheHeader
+ * \brief Header at the start of a cache file.
+ *
+ * The header is followed by \a count gTokCacheRecord structs, \a diagcount
+ * gTokCacheDiag structs and then \a stringsize bytes of NULL-terminated 
+ * strings.
+*/
+typedef struct
+{
+   char           magic[4];      //!< "GTOK"
+   unsigned int   version;       //!< GTOKCACHE_VERSION
+   unsigned int   byteorder;     //!< 0x01020304 in the byte order of the writer
+   unsigned int   count;         //!< Number of token records (the last is tEOF)
+   gHash64        contenthash;   //!< Hash of the source text
+   gHash64        parmshash;     //!< gParmsFingerprint of the parameters used
+   unsigned int   stringsize;    //!< Size of the string pool in bytes
+   unsigned int   diagcount;     //!< Number of diagnostic records
+} gTokCacheHeader;
+
+
+/**
+ * \struct gTokCacheRecord
+ * \brief A single token in a cache file.
+*/
+typedef struct
+{
+   int            type;          //!< Token type
+   int            linenum;       //!< Line number of the token
+   int            charnum;       //!< Column of the token
+   unsigned int   offset;        //!< Offset of the token string in the string pool
+} gTokCacheRecord;
+
+
+/**
+ * \def GTOKCACHE_NOSTRING
+ * \brief String offset of a NULL diagnostic argument.
+*/
+#define GTOKCACHE_NOSTRING 0xFFFFFFFF
+
+/**
+ * \struct gTokCacheDiag
+ * \brief A diagnostic reported by the lexer, stored in a cache file.
+ *
+ * The records are sorted by \a token. Each one is reported again when the
+ * token it was reported with is handed out. See gdiagnostic.h::gDiagnostic.
+*/
+typedef struct
+{
+   unsigned int   token;         //!< Index of the token record it belongs to
+   int            code;          //!< gDiagCode_e
+   int            severity;      //!< gDiagSeverity_e
+   int            linenum;       //!< Line number
+   int            charnum;       //!< Char number
+   unsigned int   sarg[2];       //!< Offsets of the string arguments or GTOKCACHE_NOSTRING
+   int            iarg[2];       //!< Integer arguments
+} gTokCacheDiag;
+
+
+/**
+ * \fn gHash64 gParmsFingerprint(const gTokenParms *parms)
+ * \brief Hashes everything in a gTokenParms that affects tokenizing.
+ *
+ * Covers the flags, keywords, symbols, escapes and all comment styles. The
+ * error functions are not included.
+ *
+ * @param[in] parms Parameters to fingerprint.
+ * @return The fingerprint.
+*/
+gHash64 gParmsFingerprint(const gTokenParms *parms);
+
+
+/**
+ * \fn gTokenStream *gOpenCachedTokenStream(const char *path, gTokenParms *parms)
+ * \brief Opens a file as a token stream backed by the token cache.
+ *
+ * Reads and hashes the file at path. If the cache file next to it was built
+ * from the same text with the same parameters, the returned stream hands out
+ * the cached tokens without lexing anything. Otherwise the file is lexed in 
+ * full right away, the cache file is rewritten, and the stream hands out the
+ * freshly lexed tokens. A failure to write the cache is not an error.
+ *
+ * Lexer diagnostics are stored in the cache. Either way, they are reported
+ * (and parms->setError called) when the token they belong to is read, the
+ * same as for an uncached stream.
+ *
+ * The returned stream is used like any other and freed with 
+ * gFreeTokenStream, which also releases the text it was read from.
+ *
+ * @param[in] path Path of the file to tokenize.
+ * @param[in] parms Parameters used for tokenizing.
+ * @return New token stream or NULL if the file could not be read.
+*/
+gTokenStream *gOpenCachedTokenStream(const char *path, gTokenParms *parms);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
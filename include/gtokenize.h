@@ -46,6 +46,7 @@ extern "C"
 #include "glist.h"
 #include "ghashtable.h"
 #include "gtextstream.h"
+#include "gdiagnostic.h"
 
 
 
@@ -110,6 +111,25 @@ typedef struct
 
 
 
+/**
+ * \struct gComment
+ * \brief Comment style definition object.
+ *
+ * Defines one comment style by the string which opens it and the string which
+ * closes it (eg. "(*" and "*)"). A nestable comment keeps track of further
+ * start strings found inside it and only ends when each of them has been
+ * closed. A list of these structs must end with an entry whose start member
+ * is NULL.
+*/
+typedef struct
+{
+   char *start;      //!< String which opens the comment
+   char *end;        //!< String which closes the comment
+   bool nestable;    //!< If true, comments of this style can be nested
+} gComment;
+
+
+
 /**
  * \enum gParseFlags_e
  * \brief Tokenizer flags.
@@ -176,7 +196,8 @@ typedef struct
     * \brief Start string of fist comment type (default: "//")
     *
     * Comments:
-    * The tokenizer supports up to two comment styles. Each specified by the 
+    * The two built-in comment styles are set here, any further styles can 
+    * be added through commentlist. Each specified by the 
     * strings. commentXs is the marker denoting the beginning of a comment
     * (eg. //) and commentXe is the marker denoting the end
     * (eg. line-end). These strings are never modified so it's safe to assign string
@@ -186,12 +207,18 @@ typedef struct
    /** \brief Start string of the second comment type (default: "/*") */
    char  *comment2s, *comment2e; //!< End string for the second comment type (default: "*/")
 
+   /** \brief Additional comment styles (default: NULL)
+   
+       List of any number of comment styles recognized along with the two 
+       above. When several start strings match, the longest one wins. */
+   gComment   *commentlist;
+
    int        flags;       //!< parser flags (defaults: 0) \see gParseFlags_e
 
    gErrorFunc setError;    //!< Pointer to the function used to set errors (defaults: internal NOP function)
    gGetErrorFunc getError; //!< Pointer to the function used to get errors (defaults: internal NOP function)
 
-   strCompFunc    strncmp; //!< This is set internally and should not be set
+   strCompFunc    strncmp; //!< Unused. Kept for compatibility, see gCompiledParms::strncmp
 } gTokenParms;
 
 
@@ -200,6 +227,8 @@ typedef struct
  * \fn gTokenParms *gNewParms()
  * 
  * Allocates and initializes and then returns a new gTokenParms structure.
+ * The object carries a hidden allocator header in front of it, so it must
+ * only be released with gFreeParms, never with free.
  *
  * @return A new allocated and initialized gTokenParms object.
 */
@@ -210,8 +239,9 @@ gTokenParms *gNewParms();
  * \fn void gFreeParms(gTokenParms *parameters)
  * \brief Frees a gTokenParms structure.
  *
- * Frees an allocated gTokenParms structure. Currently this just calls free
- * but it is recommended this function be used.
+ * Frees a gTokenParms structure made with gNewParms. This is the only way 
+ * to release it: the object is allocated with gAllocObject and the pointer
+ * is not the start of the block, so calling free on it corrupts the heap.
  *
  * @param[in] parameters A pointer to the gTokenParms object to be freed.
 */
@@ -219,6 +249,96 @@ void gFreeParms(gTokenParms *parameters);
 
 
 
+/**
+ * \struct gCompiledComment
+ * \brief Comment style as stored in a gCompiledParms object.
+*/
+typedef struct gCompiledComment
+{
+   const char *start, *end;  //!< Start and end strings of the comment
+   int   startlen, endlen;   //!< Lengths of start and end
+   bool  nestable;           //!< Comment can be nested
+
+   /** Set if the body of the comment can be skipped with memchr, that is,
+       the markers don't begin with a letter in a case-insensitive lexer. */
+   bool  scannable;
+} gCompiledComment;
+
+
+/** 
+ * \struct gCompiledParms
+ * \brief Read-only, precompiled tokenizer parameters.
+ *
+ * A snapshot of a gTokenParms object along with the values the tokenizer
+ * would otherwise recompute for every token. The tokenizer never writes to
+ * a gCompiledParms object, so a single instance can be shared by any number
+ * of token streams running on different threads. The lists referenced by the
+ * snapshot (keywords, symbols, escapes and comment strings) are not copied and
+ * must stay valid for the lifetime of the compiled object.
+ *
+ * All comment styles are merged into one table which is dispatched on the
+ * first char of the input, and symbols are chained by their first char, so 
+ * the cost of checking for a comment or symbol doesn't grow with the number
+ * of styles defined.
+ * \see  gtokenize.h::gCompileParms, gtokenize.h::gFreeCompiledParms,
+ *       gtokenize.h::gCreateCompiledTokenStream
+*/
+typedef struct gCompiledParms
+{
+   gTokenParms parms;        //!< Copy of the parameters this object was compiled from
+
+   strCompFunc strncmp;      //!< strncmp or _strnicmp depending on the gIgnoreCase flag
+
+   /** All comment styles, grouped by the first char of their start string
+       and sorted longest first within each group. */
+   gCompiledComment *comments;
+   int   numcomments;        //!< Number of entries in comments
+
+   /** Index of the first entry in comments that may start with a given char
+       and the number of entries in that group (commentfirst is -1 if none). */
+   int   commentfirst[256], commentcount[256];
+
+   /** Index of the first symbol starting with a given char, or -1. The rest
+       are chained through symbolnext in list order. */
+   int   symbolfirst[256];
+   int   *symbolnext;        //!< Next symbol with the same first char, or -1
+
+   int   maxlookahead;       //!< Number of chars gGetNextToken reads ahead to classify a token
+
+   /** Replacement for every char following a backslash in a string literal, 
+       built from escapelist. Chars not in the list map to themselves. */
+   char  escapes[256];
+
+   const gAllocator *allocator; //!< Allocator the tables were allocated with
+} gCompiledParms;
+
+
+/**
+ * \fn gCompiledParms *gCompileParms(const gTokenParms *parms)
+ * \brief Compiles a gTokenParms object.
+ *
+ * Allocates a new gCompiledParms object from the current contents of parms.
+ * Later changes to parms do not affect the compiled object.
+ *
+ * @param[in] parms The parameters to compile.
+ * @return A new gCompiledParms object or NULL if parms is NULL.
+*/
+gCompiledParms *gCompileParms(const gTokenParms *parms);
+
+
+/**
+ * \fn void gFreeCompiledParms(gCompiledParms *cparms)
+ * \brief Frees a gCompiledParms object.
+ *
+ * Frees an object created with gCompileParms. All token streams using the
+ * object must be freed first.
+ *
+ * @param[in] cparms The compiled parameters to free.
+*/
+void gFreeCompiledParms(gCompiledParms *cparms);
+
+
+
 
 // ----------------------------------------------------------------------------
 // gToken
@@ -273,7 +393,9 @@ typedef struct
  * \fn gToken *gCreateToken(const char *token, int type, int linenum, int charnum)
  * \brief Creates a token.
  *
- * Creates and returns a single token struct.
+ * Creates and returns a single token struct. The token and its string are
+ * one gAllocObject block, so release the token only with gFreeToken, never
+ * with free, and never free its token string.
  *
  * @param[in] token The actual string contents of the new token
  * @param[in] type The token type of the new token. \see gTokenType_e
@@ -284,12 +406,31 @@ typedef struct
 gToken *gCreateToken(const char *token, int type, int linenum, int charnum);
 
 
+/**
+ * \fn gToken *gCreateTokenEx(const char *token, int type, int linenum, int charnum, const gAllocator *allocator)
+ * \brief Creates a token using the given allocator.
+ *
+ * Same as gCreateToken, but the token is allocated with allocator. The token
+ * remembers its allocator, so it is freed with gFreeToken as usual.
+ *
+ * @param[in] token The actual string contents of the new token
+ * @param[in] type The token type of the new token. \see gTokenType_e
+ * @param[in] linenum The line number the token occured on. 
+ * @param[in] charnum The column number the token occured on. 
+ * @param[in] allocator Allocator for the token, NULL for the global allocator.
+ * @return A new gToken object with copies of the token string and given info.
+*/
+gToken *gCreateTokenEx(const char *token, int type, int linenum, int charnum, const gAllocator *allocator);
+
+
 /**
  * \fn void gFreeToken(void *object)
  * \brief Frees a token.
  *
- * Frees a single token. Changed for use with gList. Use this function
- * to free gToken objects created with gCreateToken.
+ * Frees a single token. Changed for use with gList. This is the only way
+ * to free gToken objects created with gCreateToken or gCreateTokenEx;
+ * calling free on them corrupts the heap. The token string is part of the
+ * same allocation, so don't free or replace it separately.
  *
  * @param[in] object The token to be freed.
 */
@@ -302,12 +443,110 @@ void gFreeToken(void *object);
 // This object is the means by which the tokenizer actually does most of the 
 // work.
 
+#ifndef DOXYGEN_IGNORE
+struct gTokenStream;
+#endif
+
+/**
+ * \struct gTokenSource
+ * \brief Producer of the tokens in a token stream.
+ *
+ * By default a token stream gets its tokens by running the lexer over its
+ * text stream. Other sources, such as the on-disk token cache, replace these
+ * functions to hand out tokens from somewhere else.
+ * \see gtokencache.h::gOpenCachedTokenStream
+*/
+typedef struct gTokenSource
+{
+   /** Produces the next token in out. The token string only has to stay
+       valid until the next call. Sets endofstream after producing tEOF. */
+   void  (*nexttoken)(struct gTokenStream *tokstrm, gToken *out);
+
+   /** Called first thing by gResetTokenStream (ignored if NULL). */
+   void  (*resetsource)(struct gTokenStream *tokstrm);
+
+   /** Called by gFreeTokenStream to release data (ignored if NULL). */
+   void  (*freesource)(struct gTokenStream *tokstrm);
+
+   /** Returns the position of the next token. Together with seeksource this
+       lets gGetToken re-read evicted tokens (if NULL, it can't). */
+   long  (*tellsource)(struct gTokenStream *tokstrm);
+
+   /** Returns to a position from tellsource. The stream's line, char and
+       endofstream fields are restored by the caller. */
+   void  (*seeksource)(struct gTokenStream *tokstrm, long position);
+
+   void  *data; //!< Data used by the source.
+} gTokenSource;
+
+
+/**
+ * \struct gTokenCheckpoint
+ * \brief Where to resume reading to get a token back.
+ *
+ * gGetToken records one checkpoint for every block of GTOKEN_BLOCKSIZE tokens
+ * it reads, taken just before the first token of the block. Checkpoint n
+ * belongs to token index n * GTOKEN_BLOCKSIZE.
+*/
+typedef struct gTokenCheckpoint
+{
+   long  position;   //!< Source position, from gTokenSource::tellsource
+   int   linenum;    //!< Line number at the position
+   int   charnum;    //!< Char number at the position
+} gTokenCheckpoint;
+
+/** Number of tokens per block of the token window and per checkpoint. */
+#define GTOKEN_BLOCKSIZE 64
+
+
+/**
+ * \enum gStatParser_e
+ * \brief Indexes of the parse routines timed by gTokenStreamStats.
+*/
+typedef enum
+{
+   gsParseString,       //!< String literals
+   gsParseHex,          //!< Hex numbers
+   gsParseNumber,       //!< Integers and decimals
+   gsParseIdentifier,   //!< Identifiers and keywords
+   gsNumParsers,        //!< Number of timed routines
+} gStatParser_e;
+
+
+/**
+ * \struct gTokenStreamStats
+ * \brief Counters kept by a token stream.
+ *
+ * The counters are only kept if gParse was compiled with GPARSE_STATS 
+ * defined. Otherwise none of the counting code exists and 
+ * gGetTokenStreamStats returns false. All counts are since the stream was 
+ * created.
+ *
+ * Cycles are read with rdtsc where available and clock() elsewhere, so 
+ * they are only meaningful relative to each other.
+*/
+typedef struct gTokenStreamStats
+{
+   guint64 bytes;                     //!< Chars consumed from the text stream
+   guint64 tokens[tLastBaseToken];    //!< Tokens handed out, by base type
+   guint64 usertokens;                //!< Tokens handed out with a type >= tLastBaseToken
+   guint64 commentbytes;              //!< Chars inside comments, markers included
+   guint64 whitespacebytes;           //!< Whitespace chars between tokens
+   guint64 readaheads;                //!< Calls to gReadahead made by the tokenizer
+   guint64 allocations;               //!< Token copies plus growths of the token buffer
+   guint64 parsecalls[gsNumParsers];  //!< Calls to each parse routine
+   guint64 parsecycles[gsNumParsers]; //!< Cycles spent in each parse routine
+} gTokenStreamStats;
+
+
 /** 
  * \struct gTokenStream
  * \brief Interface used to tokenize a gTextStream.
  *
  * This struct contains the parameters, text stream, and flags. It also is
  * responsible for managing the token cache (see: gGetToken, and gClearTCache)
+ * The cache is a window of tokens stored in a ring of fixed size pages, so
+ * tokens never move while they are cached and evicting them is O(1).
  * These structs should really only be created with gCreateTokenStream and 
  * freed with gFreeTokenStream.
  * \see  gtokenize.h::gCreateTokenStream, gtokenize.h::gFreeTokenStream,
@@ -316,7 +555,11 @@ void gFreeToken(void *object);
 */
 typedef struct gTokenStream
 {
-   gTokenParms *parameters;      //!< Pointer to the parameters object
+   /** Pointer to the parameters object. Read-only: for streams made with
+       gCreateCompiledTokenStream it points into the shared gCompiledParms. */
+   const gTokenParms *parameters;
+   const gCompiledParms *compiled; //!< Compiled parameters the tokenizer actually reads
+   gCompiledParms *owncompiled;  //!< Set if compiled was made by gCreateTokenStream and is owned by the stream
    gTextStream *stream;          //!< Pointer to the text stream.
 
    qstring_t   *tokenbuf;        //!< Temporary buffer used by the tokenizing functions
@@ -327,10 +570,27 @@ typedef struct gTokenStream
    int         charnum;          //!< Current char number within the text stream
 
    bool        endofstream;      //!< Set when gGetNextToken reaches the end of the stream
+
+   gTokenSource source;          //!< Produces the tokens (the lexer by default)
+
+   gDiagBuffer diagnostics;      //!< Errors and warnings reported while reading the stream
+
+   gTokenStreamStats *stats;     //!< Counters, NULL unless built with GPARSE_STATS
+
+   const gAllocator *allocator;  //!< Allocator for everything the stream allocates
    
-   gList       *tcache;          //!< Current list of cached tokens.
+   struct gTokenPage **window;   //!< Ring of token pages, indexed by token index
+   int         wpages;           //!< Number of pages in the ring, always a power of two
    int         cfirst;           //!< First token index in the cache
    int         clast;            //!< Last token index in the cache
+
+   gTokenCheckpoint *checkpoints; //!< One checkpoint per block read so far
+   int         ncheckpoints;     //!< Number of checkpoints
+   int         maxcheckpoints;   //!< Allocated size of checkpoints
+   struct gTokenPage *history;   //!< Block of evicted tokens re-read by gGetToken
+   int         hfirst;           //!< First token index in history
+   int         hlast;            //!< Last token index in history
+   bool        rereading;        //!< Set while evicted tokens are being re-read
 } gTokenStream;
 
 
@@ -341,6 +601,8 @@ typedef struct gTokenStream
  *
  * Creates a new tokenstream from the given parameters. If 'parms' or 'stream' is 
  * NULL, the function will not create a new token stream and will return NULL.
+ * The parameters are compiled into a private gCompiledParms object, which is
+ * recompiled by gResetTokenStream to pick up any later changes to parms.
  *
  * @param[in] parms Parameters the tokenizer/lexer should use for this stream
  * @param[in] stream Text stream the tokens should come from.
@@ -350,6 +612,55 @@ typedef struct gTokenStream
 gTokenStream *gCreateTokenStream(gTokenParms *parms, gTextStream *stream, const char *name);
 
 
+/**
+ * \fn gTokenStream *gCreateTokenStreamEx(gTokenParms *parms, gTextStream *stream, const char *name, const gAllocator *allocator)
+ * \brief Creates a token stream using the given allocator.
+ *
+ * Same as gCreateTokenStream, but everything the stream allocates (including 
+ * the tokens returned by gGetNextToken and gGetToken) comes from allocator.
+ *
+ * @param[in] parms Parameters the tokenizer/lexer should use for this stream
+ * @param[in] stream Text stream the tokens should come from.
+ * @param[in] name The name of the stream (used for error reporting)
+ * @param[in] allocator Allocator for the stream, NULL for the global allocator.
+ * @returns New token stream.
+*/
+gTokenStream *gCreateTokenStreamEx(gTokenParms *parms, gTextStream *stream, const char *name, const gAllocator *allocator);
+
+
+/**
+ * \fn gTokenStream *gCreateCompiledTokenStream(const gCompiledParms *cparms, gTextStream *stream, const char *name)
+ * \brief Creates a token stream from compiled parameters.
+ *
+ * Creates a new tokenstream which shares the given compiled parameters. The
+ * stream does not take ownership of cparms, so one gCompiledParms object can 
+ * back any number of streams on any number of threads. Returns NULL if
+ * 'cparms' or 'stream' is NULL.
+ *
+ * @param[in] cparms Compiled parameters the tokenizer/lexer should use for this stream
+ * @param[in] stream Text stream the tokens should come from.
+ * @param[in] name The name of the stream (used for error reporting)
+ * @returns New token stream.
+*/
+gTokenStream *gCreateCompiledTokenStream(const gCompiledParms *cparms, gTextStream *stream, const char *name);
+
+
+/**
+ * \fn gTokenStream *gCreateCompiledTokenStreamEx(const gCompiledParms *cparms, gTextStream *stream, const char *name, const gAllocator *allocator)
+ * \brief Creates a token stream from compiled parameters using the given allocator.
+ *
+ * Same as gCreateCompiledTokenStream, but everything the stream allocates 
+ * comes from allocator.
+ *
+ * @param[in] cparms Compiled parameters the tokenizer/lexer should use for this stream
+ * @param[in] stream Text stream the tokens should come from.
+ * @param[in] name The name of the stream (used for error reporting)
+ * @param[in] allocator Allocator for the stream, NULL for the global allocator.
+ * @returns New token stream.
+*/
+gTokenStream *gCreateCompiledTokenStreamEx(const gCompiledParms *cparms, gTextStream *stream, const char *name, const gAllocator *allocator);
+
+
 /**
  * \fn void gFreeTokenStream(gTokenStream *tokstrm)
  * \brief Frees a token stream made with gCreateTokenStream
@@ -390,16 +701,58 @@ void gResetTokenStream(gTokenStream *tokstrm);
 gToken *gGetNextToken(gTokenStream *tokstrm);
 
 
+/**
+ * \typedef gTokenCallback
+ * \brief Type of function called by gTokenizeEach for every token.
+ *
+ * The token and its string belong to the tokenizer and are only valid until
+ * the callback returns. Copy anything that needs to be kept.
+ *
+ * @param[in] token The token read from the stream.
+ * @param[in] userdata The pointer passed to gTokenizeEach.
+ * @return true to continue tokenizing, false to stop.
+*/
+typedef bool (*gTokenCallback)(gToken *token, void *userdata);
+
+
+/**
+ * \fn int gTokenizeEach(gTokenStream *tokstrm, gTokenCallback callback, void *userdata)
+ * \brief Tokenizes a stream and hands every token to a callback.
+ *
+ * Reads tokens from the stream until the end of the stream is reached or the
+ * callback returns false. Each token is passed by reference from a single
+ * reused slot, so no tokens are allocated and the token cache is not used.
+ * The closing tEOF token is not passed to the callback. This function should
+ * not be used with the same stream as gGetToken.
+ *
+ * @param[in] tokstrm The token stream to tokenize.
+ * @param[in] callback Function called with each token.
+ * @param[in] userdata Pointer passed through to the callback.
+ * @return Number of tokens passed to the callback.
+*/
+int gTokenizeEach(gTokenStream *tokstrm, gTokenCallback callback, void *userdata);
+
+
 /**
  * \fn gToken *gGetToken(gTokenStream *tokstrm, int index)
  * \brief Returns a token at the given index in the stream.
  *
- * Returns the token at the given index. Index must be >= the first token in the
- * streams cache--that is, >= strea->cfirst. If index > stream->clast, 
- * the cache of the stream is read-ahead to index. Returns NULL if index was less
- * than cfirst. If not enough tokens could be parsed from the stream to get to
- * index, the last token in the stream is returned (tEOF). This function should
- * NOT be used with the same stream as gGetNextToken.
+ * Returns the token at the given index. If index > stream->clast, the cache 
+ * of the stream is read-ahead to index. If not enough tokens could be parsed 
+ * from the stream to get to index, the last token in the stream is returned 
+ * (tEOF). This function should NOT be used with the same stream as 
+ * gGetNextToken.
+ *
+ * Tokens before stream->cfirst have been evicted by gClearTCache. They are
+ * re-read from the nearest checkpoint into a separate block of 
+ * GTOKEN_BLOCKSIZE tokens, so looking back costs at most one block of 
+ * lexing and no extra memory beyond the checkpoints. Returns NULL for an 
+ * evicted index if the token source can't seek.
+ *
+ * The returned token belongs to the stream and must not be freed. A cached
+ * token stays valid and at the same address until it is evicted by 
+ * gClearTCache or the stream is reset or freed. A re-read token stays valid
+ * until a token from another evicted block is requested.
  *
  * @param[in] tokstrm The token stream to get the token from.
  * @param[in] index The index within the stream to get the token from.
@@ -413,13 +766,51 @@ gToken *gGetToken(gTokenStream *tokstrm, int index);
  * \brief Clears the token cache inside a token stream.
  *
  * Clears the token cache within the stream. All but the very last token cached 
- * are freed.
+ * are evicted. The window keeps its memory, so this is O(1).
  *
  * @param[in] tokstrm Token stream to clear the cache of.
 */
 void gClearTCache(gTokenStream *tokstrm);
 
 
+/**
+ * \fn void gTrimTCache(gTokenStream *tokstrm, int index)
+ * \brief Evicts the cached tokens before an index.
+ *
+ * Evicts every cached token with an index less than \a index. Like 
+ * gClearTCache, the last cached token is always kept.
+ *
+ * @param[in] tokstrm Token stream to trim the cache of.
+ * @param[in] index First token index to keep.
+*/
+void gTrimTCache(gTokenStream *tokstrm, int index);
+
+
+/**
+ * \fn bool gGetTokenStreamStats(const gTokenStream *tokstrm, gTokenStreamStats *stats)
+ * \brief Copies the counters of a token stream.
+ *
+ * @param[in] tokstrm Token stream to read.
+ * @param[out] stats Receives the counters.
+ * @return false (and stats is zeroed) if gParse was built without GPARSE_STATS.
+*/
+bool gGetTokenStreamStats(const gTokenStream *tokstrm, gTokenStreamStats *stats);
+
+
+/**
+ * \fn void gReportDiagnostic(gTokenStream *tokstrm, int code, int severity, int linenum, int charnum, const char *sarg0, const char *sarg1, int iarg0, int iarg1)
+ * \brief Adds a diagnostic to the stream.
+ *
+ * The record is added to tokstrm->diagnostics. If the parameters have a
+ * setError function other than the default, the record is also formatted 
+ * and passed to it, so existing error functions keep working.
+ *
+ * \see gdiagnostic.h::gAddDiagnostic
+*/
+void gReportDiagnostic(gTokenStream *tokstrm, int code, int severity, int linenum, int charnum,
+                       const char *sarg0, const char *sarg1, int iarg0, int iarg1);
+
+
 #include "gtpattern.h"
 
 
@@ -313,7 +313,9 @@ typedef struct tPattern
 {
    tpStep *stepList; //!< Instruction set for the pattern
 
-   gHashTable *labelTable; //!< Hash table used for label name lookups
+   int   *targets;    //!< Step index each step's subLabel resolves to, -1 if it has no jump
+
+   int   linkErrors;  //!< Number of problems found in stepList by tpNewPattern
 
    gTokenStream *tstream; //!< Token stream the tokens are being read from
 
@@ -323,6 +325,10 @@ typedef struct tPattern
 
    int   ecount;  //!< Current error count
    int   wcount;  //!< Current warning count
+
+   const gAllocator *allocator; //!< Allocator for the pattern's own memory
+
+   void  *userdata; //!< Free for use by hooks, NULL when created
 };
 
 
@@ -331,7 +337,13 @@ typedef struct tPattern
  * \fn tPattern *tpNewPattern(tpStep *stepList, gTokenStream *tstream)
  * \brief Creates a new token pattern.
  *
- * Creates a new tPattern object for use with the parsing functions.
+ * Creates a new tPattern object for use with the parsing functions. The
+ * pattern allocates its memory with the allocator of tstream.
+ *
+ * Every subLabel used by an scPush or scGoto action is resolved to a step
+ * index here, and every action code is checked. Problems are reported to 
+ * tstream as fatal diagnostics and tpExecutePattern will refuse to run the
+ * pattern.
  *
  * @param[in] stepList An array of tpStep structs. This is the body of the pattern.
  * @param[in] tstream gTokenStream object used to obtain tokens.
@@ -340,6 +352,24 @@ typedef struct tPattern
 tPattern *tpNewPattern(tpStep *stepList, gTokenStream *tstream);
 
 
+/**
+ * \fn tPattern *tpNewPatternEx(tpStep *stepList, gTokenStream *tstream, const gAllocator *allocator)
+ * \brief Creates a new token pattern using the given allocator.
+ *
+ * Same as tpNewPattern, but the pattern allocates its memory (stack, step
+ * index table, stored input lists) with allocator. Like tpNewPattern, every
+ * subLabel is resolved to a step index here; the temporary label lookup 
+ * table used to do so is also allocated with allocator and freed before
+ * returning.
+ *
+ * @param[in] stepList An array of tpStep structs. This is the body of the pattern.
+ * @param[in] tstream gTokenStream object used to obtain tokens.
+ * @param[in] allocator Allocator for the pattern, NULL for the global allocator.
+ * @returns new tPattern object.
+*/
+tPattern *tpNewPatternEx(tpStep *stepList, gTokenStream *tstream, const gAllocator *allocator);
+
+
 /**
  * \fn void tpResetPattern(tPattern *p)
  * \brief Resets a token pattern
@@ -396,6 +426,12 @@ int tpIncrementCount(tPattern *p, int code);
  * Executes the given pattern object and returns the highest error level
  * encountered during execution.
  *
+ * The token processor only moves forward, so as it goes it evicts the cached
+ * tokens before the current token and before the first token in the input
+ * list (in whole blocks, see gtokenize.h::gTrimTCache). Memory use then 
+ * depends on how many tokens are stored, not on the length of the stream. 
+ * Hooks can still get evicted tokens back with gGetToken.
+ *
  * @param[in] p Pattern to be executed.
 */
 int tpExecutePattern(tPattern *p);
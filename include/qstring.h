@@ -21,7 +21,7 @@
 // Reallocating string structure
 //
 // What this "class" guarantees:
-// * The string will always be null-terminated
+// * M_QStrBuffer always returns a null-terminated string
 // * Indexing functions always check array bounds
 // * Insertion functions always reallocate when needed
 //
@@ -39,11 +39,15 @@
 #ifndef M_QSTR_H__
 #define M_QSTR_H__
 
+#include "galloc.h"
+
 typedef struct qstring_s
 {
    char *buffer;
-   unsigned int index;
+   unsigned int index;  // Length of the string; buffer[index] is only 
+                        // guaranteed to be '\0' after M_QStrBuffer
    unsigned int size;
+   const gAllocator *allocator;
 } qstring_t;
 
 
@@ -58,6 +62,15 @@ typedef struct qstring_s
 qstring_t *M_QStrInitCreate(qstring_t *qstr);
 
 
+//
+// M_QStrInitCreateEx
+//
+// Same as M_QStrInitCreate, but the buffer is allocated with the given 
+// allocator instead of the global one.
+//
+qstring_t *M_QStrInitCreateEx(qstring_t *qstr, const gAllocator *allocator);
+
+
 //
 // M_QStrCreateSize
 //
@@ -81,7 +94,8 @@ qstring_t *M_QStrCreate(qstring_t *qstr);
 //
 // M_QStrLen
 //
-// Calls strlen on the internal buffer. Convenience method.
+// Returns the length of the string. The length is tracked, so
+// this doesn't scan the buffer.
 //
 unsigned int M_QStrLen(qstring_t *qstr);
 
@@ -90,9 +104,8 @@ unsigned int M_QStrLen(qstring_t *qstr);
 // M_QStrSize
 //
 // Returns the amount of size allocated for this qstring
-// (will be >= strlen). You are allowed to index into the
-// qstring up to size - 1, although any bytes beyond the
-// strlen will be zero.
+// (will be > the length). Bytes past the length are not
+// initialized.
 //
 unsigned int M_QStrSize(qstring_t *qstr);
 
@@ -100,8 +113,9 @@ unsigned int M_QStrSize(qstring_t *qstr);
 //
 // M_QStrBuffer
 //
-// Retrieves a pointer to the internal buffer. This pointer
-// shouldn't be cached, and is not meant for writing into
+// Retrieves a pointer to the internal buffer, null-terminating
+// it first; the other methods don't keep it terminated. This 
+// pointer shouldn't be cached, and is not meant for writing into
 // (although it is safe to do so, it circumvents the
 // encapsulation and security of this structure).
 //
@@ -118,11 +132,21 @@ char *M_QStrBuffer(qstring_t *qstr);
 qstring_t *M_QStrGrow(qstring_t *qstr, unsigned int len);
 
 
+//
+// M_QStrReserve
+//
+// Makes sure len more characters fit without reallocating.
+// When the buffer has to grow it at least doubles, so appending
+// is amortized constant time.
+//
+qstring_t *M_QStrReserve(qstring_t *qstr, unsigned int len);
+
+
 //
 // M_QStrClear
 //
-// Sets the entire qstring buffer to zero, and resets the
-// insertion index. Does not reallocate the buffer.
+// Empties the qstring by resetting the insertion index. Takes
+// constant time and does not reallocate the buffer.
 //
 qstring_t *M_QStrClear(qstring_t *qstr);
 
@@ -192,6 +216,16 @@ qstring_t *M_QStrDeleteRange(qstring_t *qstr, unsigned int index, unsigned int l
 qstring_t *M_QStrCat(qstring_t *qstr, const char *str);
 
 
+//
+// M_QStrAppendN
+//
+// Appends len characters from str onto the end of a qstring, 
+// expanding the buffer if necessary. str does not need to be
+// null-terminated.
+//
+qstring_t *M_QStrAppendN(qstring_t *qstr, const char *str, unsigned int len);
+
+
 //
 // M_QStrUpr
 //
@@ -0,0 +1,161 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+#include "galloc.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+// ----------------------------------------------------------------------------
+// Default allocator
+
+static void *stdAlloc(void *context, size_t size)
+{
+   return malloc(size);
+}
+
+static void *stdRealloc(void *context, void *ptr, size_t size)
+{
+   return realloc(ptr, size);
+}
+
+static void stdFree(void *context, void *ptr)
+{
+   free(ptr);
+}
+
+static const gAllocator stdAllocator = {stdAlloc, stdRealloc, stdFree, NULL};
+
+static const gAllocator *globalAllocator = &stdAllocator;
+
+
+
+void gSetAllocator(const gAllocator *allocator)
+{
+   globalAllocator = allocator ? allocator : &stdAllocator;
+}
+
+
+
+const gAllocator *gGetAllocator(void)
+{
+   return globalAllocator;
+}
+
+
+
+void *gAlloc(const gAllocator *allocator, size_t size)
+{
+   if(!allocator)
+      allocator = globalAllocator;
+
+   return allocator->alloc(allocator->context, size);
+}
+
+
+
+void *gRealloc(const gAllocator *allocator, void *ptr, size_t size)
+{
+   if(!allocator)
+      allocator = globalAllocator;
+
+   return allocator->realloc(allocator->context, ptr, size);
+}
+
+
+
+void gFree(const gAllocator *allocator, void *ptr)
+{
+   if(!allocator)
+      allocator = globalAllocator;
+
+   if(ptr)
+      allocator->free(allocator->context, ptr);
+}
+
+
+
+char *gStrdup(const gAllocator *allocator, const char *str)
+{
+   size_t   len;
+   char     *ret;
+
+   if(!str)
+      return NULL;
+
+   len = strlen(str) + 1;
+   ret = (char *)gAlloc(allocator, len);
+   memcpy(ret, str, len);
+
+   return ret;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Objects
+// The allocator is stored in a header in front of the object. The union keeps
+// the object aligned for any type.
+
+typedef union
+{
+   const gAllocator  *allocator;
+   double            d;
+   void              *p;
+   long              l;
+} objectHeader;
+
+
+
+void *gAllocObject(const gAllocator *allocator, size_t size)
+{
+   objectHeader *header;
+
+   if(!allocator)
+      allocator = globalAllocator;
+
+   header = (objectHeader *)allocator->alloc(allocator->context, sizeof(objectHeader) + size);
+   header->allocator = allocator;
+
+   return header + 1;
+}
+
+
+
+void gFreeObject(void *object)
+{
+   objectHeader *header;
+
+   if(!object)
+      return;
+
+   header = (objectHeader *)object - 1;
+   header->allocator->free(header->allocator->context, header);
+}
@@ -0,0 +1,274 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+#include "gdiagnostic.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#define vsnprintf _vsnprintf
+#endif
+
+
+// ----------------------------------------------------------------------------
+// String arena
+// String arguments are copied into blocks which are never moved, so the
+// pointers in the records stay valid as the arena grows.
+
+#define ARENA_BLOCKSIZE 4096
+
+struct gDiagArena
+{
+   gDiagArena     *next;
+   unsigned int   used, size;
+   char           data[1];
+};
+
+
+
+static const char *arenaCopy(gDiagBuffer *buffer, const char *str)
+{
+   gDiagArena     *block = buffer->arena;
+   unsigned int   len;
+   char           *ret;
+
+   if(!str)
+      return NULL;
+
+   len = strlen(str) + 1;
+
+   if(!block || block->used + len > block->size)
+   {
+      unsigned int size = len > ARENA_BLOCKSIZE ? len : ARENA_BLOCKSIZE;
+
+      block = (gDiagArena *)gAlloc(buffer->allocator, sizeof(gDiagArena) + size);
+      block->used = 0;
+      block->size = size;
+      block->next = buffer->arena;
+      buffer->arena = block;
+   }
+
+   ret = block->data + block->used;
+   memcpy(ret, str, len);
+   block->used += len;
+
+   return ret;
+}
+
+
+
+static void freeArena(gDiagBuffer *buffer)
+{
+   gDiagArena *block, *next;
+
+   for(block = buffer->arena; block; block = next)
+   {
+      next = block->next;
+      gFree(buffer->allocator, block);
+   }
+
+   buffer->arena = NULL;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// gDiagBuffer
+
+void gInitDiagnostics(gDiagBuffer *buffer)
+{
+   memset(buffer, 0, sizeof(*buffer));
+   buffer->allocator = gGetAllocator();
+}
+
+
+
+void gFreeDiagnostics(gDiagBuffer *buffer)
+{
+   freeArena(buffer);
+
+   if(buffer->list)
+      gFree(buffer->allocator, buffer->list);
+
+   buffer->list = NULL;
+   buffer->count = buffer->max = 0;
+}
+
+
+
+void gClearDiagnostics(gDiagBuffer *buffer)
+{
+   freeArena(buffer);
+   buffer->count = 0;
+}
+
+
+
+void gSetDiagnosticSink(gDiagBuffer *buffer, gDiagSink sink, void *context)
+{
+   buffer->sink = sink;
+   buffer->context = context;
+}
+
+
+
+const gDiagnostic *gAddDiagnostic(gDiagBuffer *buffer, int code, int severity, const char *stream, 
+                                  int linenum, int charnum, const char *sarg0, const char *sarg1, 
+                                  int iarg0, int iarg1)
+{
+   gDiagnostic *d;
+
+   if(buffer->count == buffer->max)
+   {
+      buffer->max = buffer->max ? buffer->max * 2 : 16;
+      buffer->list = (gDiagnostic *)gRealloc(buffer->allocator, buffer->list, sizeof(gDiagnostic) * buffer->max);
+   }
+
+   d = buffer->list + buffer->count++;
+
+   d->code = code;
+   d->severity = severity;
+   d->stream = stream;
+   d->linenum = linenum;
+   d->charnum = charnum;
+   d->sarg[0] = arenaCopy(buffer, sarg0);
+   d->sarg[1] = arenaCopy(buffer, sarg1);
+   d->iarg[0] = iarg0;
+   d->iarg[1] = iarg1;
+   d->context = buffer->context;
+
+   if(buffer->sink)
+      buffer->sink(d, buffer->context);
+
+   return d;
+}
+
+
+
+int gGetDiagnosticCount(const gDiagBuffer *buffer)
+{
+   return buffer->count;
+}
+
+
+
+const gDiagnostic *gGetDiagnostic(const gDiagBuffer *buffer, int index)
+{
+   if(index < 0 || index >= buffer->count)
+      return NULL;
+
+   return buffer->list + index;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Formatting
+
+// appendText
+// Appends formatted text at len, always leaving buffer terminated. Returns 
+// the new length.
+static int appendText(char *buffer, int size, int len, const char *fmt, ...)
+{
+   va_list  args;
+   int      ret;
+
+   if(len >= size - 1)
+      return len;
+
+   va_start(args, fmt);
+   ret = vsnprintf(buffer + len, size - len, fmt, args);
+   va_end(args);
+
+   // _vsnprintf returns -1 and doesn't terminate when the text is cut.
+   if(ret < 0 || ret >= size - len)
+   {
+      buffer[size - 1] = 0;
+      return size - 1;
+   }
+
+   return len + ret;
+}
+
+
+
+int gFormatDiagnostic(const gDiagnostic *diag, char *buffer, int size)
+{
+   const char  *name = diag->stream ? diag->stream : "";
+   int         len = 0;
+
+   if(!buffer || size <= 0)
+      return 0;
+
+   buffer[0] = 0;
+
+   switch(diag->code)
+   {
+      case gdUnterminatedString:
+         return appendText(buffer, size, 0, "%s(%i, %i): Unterminated string literal.\n", name, diag->linenum, diag->charnum);
+      case gdExpectedHex:
+         return appendText(buffer, size, 0, "%s(%i, %i): Expected a Hex value after '0x'", name, diag->linenum, diag->charnum);
+      case gdExpectedExponent:
+         return appendText(buffer, size, 0, "%s(%i, %i): Expected numeric value in exponent.", name, diag->linenum, diag->charnum);
+      case gdUnknownChar:
+         return appendText(buffer, size, 0, "%s(%i, %i): Unknown char encountered.\n", name, diag->linenum, diag->charnum);
+
+      case gdPatternThrow:
+         if(diag->severity == gdWarning)
+            len = appendText(buffer, size, 0, "Warning ");
+         else if(diag->severity == gdError)
+            len = appendText(buffer, size, 0, "Error ");
+         else
+            len = appendText(buffer, size, 0, "Fatal Error ");
+
+         len = appendText(buffer, size, len, "%s(%i, %i): ", name, diag->linenum, diag->charnum);
+
+         // The message is the format string given to the step.
+         len = appendText(buffer, size, len, diag->sarg[0] ? diag->sarg[0] : "", diag->sarg[1] ? diag->sarg[1] : "");
+         return appendText(buffer, size, len, "\n");
+
+      case gdPatternNoLabel:
+         return appendText(buffer, size, 0, "Pattern error: Step %i with an opcode requiring a label had no label.\n", diag->iarg[0]);
+      case gdPatternBadLabel:
+         return appendText(buffer, size, 0, "Pattern error: Step %i: Label '%s' not found in pattern.\n", diag->iarg[0], diag->sarg[0] ? diag->sarg[0] : "");
+      case gdPatternBadOp:
+         return appendText(buffer, size, 0, "Pattern error: Step %i has an unrecognized action code.\n", diag->iarg[0]);
+      case gdPatternEOF:
+         return appendText(buffer, size, 0, "%s: Unexpected EOF", name);
+      case gdPatternSummary:
+         return appendText(buffer, size, 0, "%s: %i Errors, %i Warnings", name, diag->iarg[0], diag->iarg[1]);
+      case gdCannotOpen:
+         return appendText(buffer, size, 0, "%s: Unable to open file.", name);
+   }
+
+   return appendText(buffer, size, 0, "%s(%i, %i): Unknown diagnostic %i", name, diag->linenum, diag->charnum, diag->code);
+}
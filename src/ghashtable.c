@@ -32,322 +32,1628 @@
 #include <string.h>
 #include <ctype.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GHASH_SSE2
+#endif
+
 // ----------------------------------------------------------------------------
 // gHashTable
 // Generalized hash table which associates an object with a unique string
 // identifier. 
+//
+// The table uses open addressing. Slots live in one flat array, and a 
+// parallel array holds one control byte per slot: either a 7 bit tag taken
+// from the hash of the key, or one of the markers below. Lookups probe 
+// whole groups of GHASH_GROUPSIZE control bytes at a time (with SSE2 where
+// available), and only compare keys of slots whose tag and stored hash 
+// match.
 
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xFE
 
-// SoM: This is only ever used in this file
-// This is the object type that's actually stored in the lists
-typedef struct gHashItem
-{
-   // This is the key associated with the object
-   char *key;
-
-   // This is the object 
-   void *object;
-
-   // This is the function that should be used to free the object when it is
-   // deleted. (This is 'inherited' from the gHashTable object)
-   void (*freeFunc)(void *object);
+#define MIN_CAPACITY GHASH_GROUPSIZE
 
-   // Next item in the chain
-   struct gHashItem *next, *prev;
-} gHashItem;
+// Groups of old slots moved to the new arrays by each add or remove while the
+// table is growing. Anything from 1 up finishes the move before the new 
+// arrays fill up.
+#define MIGRATE_GROUPS 2
 
+// This is the object type that's actually stored in the slots.
+struct gHashSlot
+{
+   unsigned int   hash;    // Full hash of the key
+   unsigned int   len;     // Length of string and span keys
+   const char     *key;    // Key (a copy for string keys), or the integer or pointer
+   void           *object;
+};
 
 
 void hashFreeNOP(void *obj) {}
 
-// Used to free the entry objects.
-static void freeHashEntry(gHashItem *item)
-{
-   if(!item)
-      return;
 
-   item->freeFunc(item->object);
-   free(item->key);
-   free(item);
+// Mixes the bits of a hash so the low bits (group index) and the high bits
+// (tag) are both usable.
+static unsigned int mixHash(unsigned int h)
+{
+   h ^= h >> 16;
+   h *= 0x85EBCA6B;
+   h ^= h >> 13;
+   h *= 0xC2B2AE35;
+   h ^= h >> 16;
+   return h;
 }
 
 
-static unsigned calcHashKey(const char *string)
+static unsigned calcHashKey(const char *key, unsigned int len)
 {
-   const char *c = string;
-   unsigned h = 0;
-
-   if(!string)
-      return 0;
+   const unsigned char *c = (const unsigned char *)key, *end = c + len;
+   unsigned h = 2166136261u;
 
-   while(*c)
+   while(c < end)
    {
-      h = 5 * h + toupper(*c);
+      h = (h ^ toupper(*c)) * 16777619u;
       ++c;
    }
 
-   return h;
+   return mixHash(h);
 }
 
 
 
-static unsigned calcHashKeyS(const char *string)
+static unsigned calcHashKeyS(const char *key, unsigned int len)
 {
-   const char *c = string;
-   unsigned h = 0;
-
-   if(!string)
-      return 0;
+   const unsigned char *c = (const unsigned char *)key, *end = c + len;
+   unsigned h = 2166136261u;
 
-   while(*c)
+   while(c < end)
    {
-      h = 5 * h + *c;
+      h = (h ^ *c) * 16777619u;
       ++c;
    }
 
-   return h;
+   return mixHash(h);
 }
 
 
-static gHashItem *makeChainHead()
+// Hashes integer and pointer keys, which are stored in the key pointer.
+static unsigned calcHashWord(const char *key, unsigned int len)
 {
-   gHashItem *it = malloc(sizeof(gHashItem));
-   memset(it, 0, sizeof(*it));
-   it->next = it->prev = it;
-   return it;
+   size_t   word = (size_t)key;
+   unsigned h = (unsigned)word;
+
+   // Two shifts so this is defined for 32 bit size_t as well.
+   if(sizeof(size_t) > sizeof(unsigned))
+      h ^= (unsigned)((word >> 16) >> 16);
+
+   return mixHash(h);
 }
 
 
+// Keys of integer and pointer tables are compared directly, the others 
+// through compFunc.
+static bool keysMatch(gHashTable *table, const gHashSlot *slot, const char *key, unsigned int len)
+{
+   if(!table->compFunc)
+      return slot->key == key;
 
+   return slot->len == len && !table->compFunc(slot->key, key, len);
+}
 
-// gNewHashTable
-// Creates a new gHashTable object. If freeFunc is null, the code assumes the
-// objects in the table should not be freed when they are removed or the table 
-// is freed.
-gHashTable *gNewHashTable(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase)
+
+// ----------------------------------------------------------------------------
+// Key arena
+// String tables copy their keys into chunks that are only freed with the 
+// table, so adding a key is a bump of a pointer instead of an allocation. 
+// Chunks double in size up to KEYCHUNK_MAX. Bytes of removed keys are 
+// counted, and the live keys are packed into a fresh chunk by gRehashTable,
+// or when the arena would otherwise grow while it's mostly dead keys.
+
+#define KEYCHUNK_MIN 256
+#define KEYCHUNK_MAX 65536
+
+struct gKeyChunk
 {
-   gHashTable *ret;
-   unsigned    i;
+   struct gKeyChunk  *next;
+   size_t            size;    // Bytes of data after the header
+   size_t            used;
+};
 
-   if(!numChains)
-      return NULL;
 
-   ret = malloc(sizeof(gHashTable));
-   memset(ret, 0, sizeof(*ret));
+static char *keyChunkData(gKeyChunk *chunk)
+{
+   return (char *)(chunk + 1);
+}
 
-   ret->chains = gNewList(free);
 
-   if(freeFunc == NULL)
-      ret->freeFunc = hashFreeNOP;
-   else
-      ret->freeFunc = freeFunc;
+// newKeyChunk
+// Adds a chunk with room for at least need bytes to the table.
+static gKeyChunk *newKeyChunk(gHashTable *table, size_t need)
+{
+   gKeyChunk   *chunk;
+   size_t      size = table->keyChunks ? table->keyChunks->size * 2 : KEYCHUNK_MIN;
 
-   for(i = 0; i < numChains; i++)
-      gAppendListItem(ret->chains, makeChainHead());
+   if(size > KEYCHUNK_MAX)
+      size = KEYCHUNK_MAX;
+   if(size < need)
+      size = need;
 
-   if(ignoreCase)
-   {
-      ret->hashFunc = calcHashKey;
-      ret->compFunc = _stricmp;
-   }
-   else
+   chunk = (gKeyChunk *)gAlloc(table->allocator, sizeof(gKeyChunk) + size);
+   chunk->size = size;
+   chunk->used = 0;
+   chunk->next = table->keyChunks;
+   table->keyChunks = chunk;
+
+   return chunk;
+}
+
+
+static void packKeys(gHashTable *table);
+
+
+// copyKey
+// Copies len chars of key into the arena, NUL terminated.
+static char *copyKey(gHashTable *table, const char *key, unsigned int len)
+{
+   gKeyChunk   *chunk = table->keyChunks;
+   char        *ret;
+
+   if(!chunk || chunk->used + len + 1 > chunk->size)
    {
-      ret->hashFunc = calcHashKeyS;
-      ret->compFunc = strcmp;
+      // Pack rather than grow if at least half the arena is removed keys.
+      // Requiring as many dead bytes as there are slots keeps the walk 
+      // over the slots paid for by the removals.
+      if(table->deadKeyBytes * 2 >= table->keyBytes && 
+         table->deadKeyBytes >= table->capacity + table->oldCapacity)
+      {
+         packKeys(table);
+         chunk = table->keyChunks;
+      }
+
+      if(!chunk || chunk->used + len + 1 > chunk->size)
+         chunk = newKeyChunk(table, len + 1);
    }
 
+   ret = keyChunkData(chunk) + chunk->used;
+   memcpy(ret, key, len);
+   ret[len] = 0;
+   chunk->used += len + 1;
+   table->keyBytes += len + 1;
+
    return ret;
 }
 
 
-// gFreeHashTable
-// Frees the given hash table, deleteing all the bins which free all contained
-// objects.
-void gFreeHashTable(gHashTable *table)
+static void freeKeyChunks(gHashTable *table, gKeyChunk *chunk)
 {
-   unsigned i;
-   gHashItem *head, *it, *next;
+   gKeyChunk *next;
 
-   if(!table)
-      return;
+   for(; chunk; chunk = next)
+   {
+      next = chunk->next;
+      gFree(table->allocator, chunk);
+   }
+}
 
 
-   for(i = 0; i < table->chains->size; i++)
+static void packSlots(gHashTable *table, const unsigned char *ctrl, gHashSlot *slots, unsigned int capacity)
+{
+   unsigned int i;
+
+   for(i = 0; i < capacity; i++)
    {
-      head = (gHashItem *)gGetListItem(table->chains, i);
+      if(!(ctrl[i] & 0x80))
+         slots[i].key = copyKey(table, slots[i].key, slots[i].len);
+   }
+}
 
-      for(it = head->next; it != head; it = next)
-      {
-         next = it->next;
-         freeHashEntry(it);
-         it = next; 
-      }
+
+// packKeys
+// Copies the live keys, including those still in the old arrays, into one
+// new chunk and frees the old chunks.
+static void packKeys(gHashTable *table)
+{
+   gKeyChunk   *old = table->keyChunks;
+   size_t      live = table->keyBytes - table->deadKeyBytes;
+
+   table->keyChunks = NULL;
+   table->keyBytes = table->deadKeyBytes = 0;
+
+   if(live)
+      newKeyChunk(table, live);
+
+   packSlots(table, table->ctrl, table->slots, table->capacity);
+   if(table->oldCtrl)
+      packSlots(table, table->oldCtrl, table->oldSlots, table->oldCapacity);
+
+   freeKeyChunks(table, old);
+}
+
+
+// Only string tables own their keys. Their bytes are given back when the
+// arena is packed or freed.
+static void freeKey(gHashTable *table, const gHashSlot *slot)
+{
+   if(table->keyType == ghStringKeys)
+      table->deadKeyBytes += slot->len + 1;
+}
+
+
+static unsigned char hashTag(unsigned int hash)
+{
+   return (unsigned char)(hash >> 25);
+}
+
+
+// ----------------------------------------------------------------------------
+// Group matching
+// Each returns a bit mask with bit i set if control byte i of the group
+// matches.
+
+#ifdef GHASH_SSE2
+static unsigned int matchTag(const unsigned char *group, unsigned char tag)
+{
+   __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+   return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)tag)));
+}
+
+static unsigned int matchEmpty(const unsigned char *group)
+{
+   return matchTag(group, CTRL_EMPTY);
+}
+
+// Empty and deleted are the only control bytes with the high bit set.
+static unsigned int matchFree(const unsigned char *group)
+{
+   return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+#else
+static unsigned int matchTag(const unsigned char *group, unsigned char tag)
+{
+   unsigned int i, mask = 0;
+
+   for(i = 0; i < GHASH_GROUPSIZE; i++)
+      mask |= (group[i] == tag) << i;
+
+   return mask;
+}
+
+static unsigned int matchEmpty(const unsigned char *group)
+{
+   return matchTag(group, CTRL_EMPTY);
+}
+
+static unsigned int matchFree(const unsigned char *group)
+{
+   unsigned int i, mask = 0;
+
+   for(i = 0; i < GHASH_GROUPSIZE; i++)
+      mask |= ((group[i] & 0x80) != 0) << i;
+
+   return mask;
+}
+#endif
+
+
+// Index of the lowest set bit of a non-zero mask.
+static unsigned int lowestBit(unsigned int mask)
+{
+   unsigned int i = 0;
+
+   while(!(mask & 1))
+   {
+      mask >>= 1;
+      i++;
    }
 
-   gFreeList(table->chains);
-   free(table);
+   return i;
 }
 
 
 
-// gRehashTable
-// Resizes and re-hashes the given table to the specified number of bins
-bool gRehashTable(gHashTable *table, unsigned int numChains)
+// ----------------------------------------------------------------------------
+// Slot management
+
+// Items allowed in a table of the given capacity (7/8 load).
+static unsigned int maxLoad(unsigned int capacity)
 {
-   unsigned int i;
-   gHashItem    *list = NULL, *it, *next;
+   return capacity - capacity / 8;
+}
 
-   // check everything out
-   if(!table || !numChains || !table->chains->size || 
-      numChains == table->chains->size)
-      return false;
 
-   // Gather all the hash items
-   for(i = 0; i < table->chains->size; i++)
+// allocSlots
+// Gives the table empty arrays for capacity slots.
+static void allocSlots(gHashTable *table, unsigned int capacity)
+{
+   table->capacity = capacity;
+   table->ctrl = (unsigned char *)gAlloc(table->allocator, capacity);
+   table->slots = (gHashSlot *)gAlloc(table->allocator, sizeof(gHashSlot) * capacity);
+   table->growthLeft = maxLoad(capacity);
+
+   memset(table->ctrl, CTRL_EMPTY, capacity);
+}
+
+
+// probeSlots
+// Returns the slot of the given arrays holding key, or -1 if it's not there.
+static int probeSlots(gHashTable *table, const unsigned char *ctrls, const gHashSlot *slots, 
+                      unsigned int capacity, const char *key, unsigned int len, unsigned int hash)
+{
+   unsigned int   groupmask = capacity / GHASH_GROUPSIZE - 1;
+   unsigned int   group = hash & groupmask, probe = 0;
+   unsigned char  tag = hashTag(hash);
+
+   while(1)
    {
-      gHashItem *head = (gHashItem *)gGetListItem(table->chains, i);
-      gHashItem *first, *last;
+      const unsigned char *ctrl = ctrls + group * GHASH_GROUPSIZE;
+      unsigned int         mask = matchTag(ctrl, tag);
 
-      // If there are items in the chain, add it to the gathering chain.
-      if(head->next != head)
+      while(mask)
       {
-         first = head->next;
-         last = head->prev;
+         unsigned int i = group * GHASH_GROUPSIZE + lowestBit(mask);
 
-         head->next = head->prev = head;
-         first->prev = last->next = NULL;
-      }
-      else
-         first = last = NULL;
+         if(slots[i].hash == hash && keysMatch(table, &slots[i], key, len))
+            return (int)i;
 
-      if(!list && first)
-         list = first;
-      else if(first && last)
-      {
-         (last->next = list)->prev = last;
-         list = first;
+         mask &= mask - 1;
       }
+
+      // A probe sequence never continues past a group with an empty slot.
+      if(matchEmpty(ctrl))
+         return -1;
+
+      // Triangular probing visits every group of a power of two table.
+      group = (group + ++probe) & groupmask;
    }
+}
 
-   // Expand the table if the new size is larger.
-   while(table->chains->size < numChains)
-      gAppendListItem(table->chains, makeChainHead());
 
-   // Delete extra chains if the new size is smaller.
-   if(table->chains->size > numChains)      
-      gDeleteListRange(table->chains, numChains, table->chains->size - 1);
+// findSlot
+// Returns the slot holding key in the current arrays, or -1 if it's not 
+// there. If the table is growing, the old arrays are checked as well and 
+// oldp is set if the item was found in them.
+static int findSlot(gHashTable *table, const char *key, unsigned int len, unsigned int hash, bool *oldp)
+{
+   int i = probeSlots(table, table->ctrl, table->slots, table->capacity, key, len, hash);
+
+   if(oldp)
+      *oldp = false;
 
-   // Now, run through the collector chain and hash items it contains.
-   for(it = list; it; it = next)
+   if(i < 0 && table->oldCtrl)
    {
-      unsigned int index = table->hashFunc(it->key) % table->chains->size;
-      gHashItem *head;
-      
-      next = it->next;
-      head = (gHashItem *)gGetListItem(table->chains, index);
-      if(!head)
-      {
-         // Error out?
-         continue;
-      }
+      i = probeSlots(table, table->oldCtrl, table->oldSlots, table->oldCapacity, key, len, hash);
 
-      (it->next = head->next)->prev = it;
-      (it->prev = head)->next = it;
+      if(oldp)
+         *oldp = true;
    }
 
-   return true;
+   return i;
+}
+
+
+// findFreeSlot
+// Returns the first empty or deleted slot in the probe sequence of hash.
+static unsigned int findFreeSlot(gHashTable *table, unsigned int hash)
+{
+   unsigned int groupmask = table->capacity / GHASH_GROUPSIZE - 1;
+   unsigned int group = hash & groupmask, probe = 0;
+   unsigned int mask;
+
+   while(!(mask = matchFree(table->ctrl + group * GHASH_GROUPSIZE)))
+      group = (group + ++probe) & groupmask;
+
+   return group * GHASH_GROUPSIZE + lowestBit(mask);
 }
 
 
+// placeSlot
+// Stores a slot at the first free position for its hash.
+static void placeSlot(gHashTable *table, const gHashSlot *slot)
+{
+   unsigned int i = findFreeSlot(table, slot->hash);
+
+   if(table->ctrl[i] == CTRL_EMPTY)
+      table->growthLeft--;
 
+   table->ctrl[i] = hashTag(slot->hash);
+   table->slots[i] = *slot;
+}
 
-// This is a bit hackish but it works. This is used by another function to get
-// the bin found by findHashItem so the key function doesn't have to be called
-// twice.
-static gHashItem *foundHead = NULL;
 
-static gHashItem *findHashItem(gHashTable *table, const char *key)
+// migrateSlots
+// Moves up to count old slots into the current arrays. The moved slots are
+// marked deleted so probing the old arrays still works. Frees the old 
+// arrays once they're empty.
+static void migrateSlots(gHashTable *table, unsigned int count)
 {
-   gHashItem *item, *head;
-   unsigned int index;
+   unsigned int i, end;
 
-   if(!table || !key)
-      return NULL;
+   if(!table->oldCtrl)
+      return;
 
-   index = table->hashFunc(key) % table->chains->size;
-   foundHead = head = (gHashItem *)gGetListItem(table->chains, index);
+   end = table->migrated + count;
+   if(end > table->oldCapacity)
+      end = table->oldCapacity;
 
-   for(item = head->next; item != head; item = item->next)
+   for(i = table->migrated; i < end; i++)
    {
-      if(!table->compFunc(item->key, key))
-         return item;
+      if(!(table->oldCtrl[i] & 0x80))
+      {
+         placeSlot(table, &table->oldSlots[i]);
+         table->oldCtrl[i] = CTRL_DELETED;
+      }
    }
 
-   return NULL;
+   table->migrated = end;
+
+   if(end == table->oldCapacity)
+   {
+      gFree(table->allocator, table->oldCtrl);
+      gFree(table->allocator, table->oldSlots);
+      table->oldCtrl = NULL;
+      table->oldSlots = NULL;
+      table->oldCapacity = table->migrated = 0;
+   }
 }
 
 
+// startResize
+// Switches to new arrays of the given capacity. The items are moved over 
+// by migrateSlots. This also clears out deleted slots.
+static void startResize(gHashTable *table, unsigned int capacity)
+{
+   unsigned char  *ctrl = table->ctrl;
+   gHashSlot      *slots = table->slots;
+   unsigned int   i, oldcap = table->capacity;
+
+   // Deleted slots ran the arrays full before the last move was done. Move
+   // the current items right away and leave the old arrays where they are,
+   // only one set of arrays can be moved at a time.
+   if(table->oldCtrl)
+   {
+      allocSlots(table, capacity);
+
+      for(i = 0; i < oldcap; i++)
+      {
+         if(!(ctrl[i] & 0x80))
+            placeSlot(table, &slots[i]);
+      }
+
+      gFree(table->allocator, ctrl);
+      gFree(table->allocator, slots);
+      return;
+   }
 
-// gAddTableItem
-// Attempts to add the given object to the hash table. If the given key already exists
-// the function will return false. Otherwise returns true. The string passed will be
-// copied. The gHashTable will not free the string you pass to this function.
-bool gAddTableItem(gHashTable *table, const char *key, void *item)
+   table->oldCtrl = ctrl;
+   table->oldSlots = slots;
+   table->oldCapacity = oldcap;
+   table->migrated = 0;
+
+   allocSlots(table, capacity);
+}
+
+
+// resizeTable
+// Moves all items into new arrays of the given capacity right away.
+static void resizeTable(gHashTable *table, unsigned int capacity)
 {
-   gHashItem *it;
+   startResize(table, capacity);
+   migrateSlots(table, table->oldCapacity);
+}
 
-   if(!table || !key || !item)
-      return false;
 
-   if(findHashItem(table, key))
-      return false;
+// Smallest power of two capacity that holds count items.
+static unsigned int capacityFor(unsigned int count)
+{
+   unsigned int capacity = MIN_CAPACITY;
 
-   it = malloc(sizeof(gHashItem));
-   memset(it, 0, sizeof(*it));
+   while(maxLoad(capacity) < count)
+      capacity <<= 1;
 
-   it->freeFunc = table->freeFunc;
-   it->key = _strdup(key);
-   it->object = item;
+   return capacity;
+}
 
-   (it->next = foundHead->next)->prev = it;
-   (it->prev = foundHead)->next = it;
 
-   table->itemCount++;
 
-   return true;
+// gNewHashTable
+// Creates a new gHashTable object. If freeFunc is null, the code assumes the
+// objects in the table should not be freed when they are removed or the table 
+// is freed.
+gHashTable *gNewHashTable(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase)
+{
+   return gNewKeyedHashTableEx(numChains, freeFunc, ghStringKeys, ignoreCase, NULL);
 }
 
 
-// gFindTableItem
-// Searches the hash table for the given key and returns a pointer to the associated
-// object (returns NULL on fail)
-void *gFindTableItem(gHashTable *table, const char *key)
+// gNewHashTableEx
+// Same as gNewHashTable, allocating everything with the given allocator.
+gHashTable *gNewHashTableEx(unsigned numChains, void (*freeFunc)(void *), bool ignoreCase, const gAllocator *allocator)
 {
-   gHashItem *item = findHashItem(table, key);
+   return gNewKeyedHashTableEx(numChains, freeFunc, ghStringKeys, ignoreCase, allocator);
+}
+
 
-   return item ? item->object : NULL;
+// gNewKeyedHashTable
+// Creates a new table for the given kind of keys.
+gHashTable *gNewKeyedHashTable(unsigned numChains, void (*freeFunc)(void *), gHashKeys_e keyType, bool ignoreCase)
+{
+   return gNewKeyedHashTableEx(numChains, freeFunc, keyType, ignoreCase, NULL);
 }
 
 
-// gRemoveTableItem
-// Searches the hash table for the given key and removes it from the bin. If 
-// the table is set to free objects, it will be freed. Returns true if the
-// key was found, or false if it was not.
-bool gRemoveTableItem(gHashTable *table, const char *key)
+// gNewKeyedHashTableEx
+// Same as gNewKeyedHashTable, allocating everything with the given allocator.
+gHashTable *gNewKeyedHashTableEx(unsigned numChains, void (*freeFunc)(void *), gHashKeys_e keyType, 
+                                 bool ignoreCase, const gAllocator *allocator)
 {
-   gHashItem *it = findHashItem(table, key);
+   gHashTable *ret;
+
+   if(!numChains)
+      return NULL;
+
+   if(!allocator)
+      allocator = gGetAllocator();
+
+   ret = gAlloc(allocator, sizeof(gHashTable));
+   memset(ret, 0, sizeof(*ret));
+
+   ret->allocator = allocator;
+   ret->keyType = keyType;
+
+   if(freeFunc == NULL)
+      ret->freeFunc = hashFreeNOP;
+   else
+      ret->freeFunc = freeFunc;
 
-   if(it != NULL)
+   if(keyType == ghIntKeys || keyType == ghPointerKeys)
+   {
+      ret->hashFunc = calcHashWord;
+      ret->compFunc = NULL;
+   }
+   else if(ignoreCase)
+   {
+      ret->hashFunc = calcHashKey;
+      ret->compFunc = _strnicmp;
+   }
+   else
    {
-      (it->next->prev = it->prev)->next = it->next;
+      ret->hashFunc = calcHashKeyS;
+      ret->compFunc = strncmp;
+   }
 
-      freeHashEntry(it);
-      table->itemCount--;
-      return true;
+   allocSlots(ret, capacityFor(numChains));
+
+   return ret;
+}
+
+
+// gFreeHashTable
+// Frees the given hash table, freeing all contained objects.
+void gFreeHashTable(gHashTable *table)
+{
+   unsigned int i;
+
+   if(!table)
+      return;
+
+   // Keys go with the arena, so the slots only need a visit if there are
+   // objects to free.
+   if(table->freeFunc != hashFreeNOP)
+   {
+      for(i = 0; i < table->capacity; i++)
+      {
+         if(!(table->ctrl[i] & 0x80))
+            table->freeFunc(table->slots[i].object);
+      }
+
+      for(i = table->migrated; i < table->oldCapacity; i++)
+      {
+         if(!(table->oldCtrl[i] & 0x80))
+            table->freeFunc(table->oldSlots[i].object);
+      }
    }
 
-   return false;
+   freeKeyChunks(table, table->keyChunks);
+
+   gFree(table->allocator, table->oldCtrl);
+   gFree(table->allocator, table->oldSlots);
+
+   gFree(table->allocator, table->ctrl);
+   gFree(table->allocator, table->slots);
+   gFree(table->allocator, table);
+}
+
+
+
+// gRehashTable
+// Resizes the table so it holds at least numChains items without growing.
+bool gRehashTable(gHashTable *table, unsigned int numChains)
+{
+   if(!table || !numChains)
+      return false;
+
+   if(numChains < table->itemCount)
+      numChains = table->itemCount;
+
+   resizeTable(table, capacityFor(numChains));
+
+   // Pack the live keys into one chunk, dropping the removed ones.
+   if(table->deadKeyBytes)
+      packKeys(table);
+
+   return true;
 }
 
 
 
+// gFinishTableResize
+// Moves the remaining items out of the old arrays and frees them.
+void gFinishTableResize(gHashTable *table)
+{
+   if(table)
+      migrateSlots(table, table->oldCapacity);
+}
+
+
+
+// addItem
+// Adds an item under a key of any kind, with its hash computed already.
+static bool addItem(gHashTable *table, const char *key, unsigned int len, unsigned int hash, void *item)
+{
+   gHashSlot slot;
+
+   if(!item || findSlot(table, key, len, hash, NULL) >= 0)
+      return false;
+
+   migrateSlots(table, MIGRATE_GROUPS * GHASH_GROUPSIZE);
+
+   // Out of empty slots: grow, or just clear out the deleted slots if 
+   // the table is less than half full.
+   if(!table->growthLeft)
+      startResize(table, table->itemCount < maxLoad(table->capacity) / 2 ? table->capacity : table->capacity * 2);
+
+   slot.hash = hash;
+   slot.len = len;
+   slot.key = table->keyType == ghStringKeys ? copyKey(table, key, len) : key;
+   slot.object = item;
+   placeSlot(table, &slot);
+
+   table->itemCount++;
+
+   return true;
+}
+
+
+// findItem
+// Returns the object stored under a key of any kind, or NULL.
+static void *findItem(gHashTable *table, const char *key, unsigned int len, unsigned int hash)
+{
+   bool old;
+   int  i = findSlot(table, key, len, hash, &old);
+
+   if(i < 0)
+      return NULL;
+
+   return old ? table->oldSlots[i].object : table->slots[i].object;
+}
+
+
+// removeItem
+// Removes the item stored under a key of any kind.
+static bool removeItem(gHashTable *table, const char *key, unsigned int len, unsigned int hash)
+{
+   unsigned int   group;
+   bool           old;
+   int            i;
+
+   if((i = findSlot(table, key, len, hash, &old)) < 0)
+      return false;
+
+   // Items still in the old arrays just get marked, the arrays are going
+   // away anyway.
+   if(old)
+   {
+      table->oldCtrl[i] = CTRL_DELETED;
+      table->freeFunc(table->oldSlots[i].object);
+      freeKey(table, &table->oldSlots[i]);
+      table->itemCount--;
+      migrateSlots(table, MIGRATE_GROUPS * GHASH_GROUPSIZE);
+      return true;
+   }
+
+   // If the group still has an empty slot, no probe sequence ever went past
+   // it, so the slot can become empty again. Otherwise it has to be marked
+   // deleted to keep later items reachable.
+   group = i - i % GHASH_GROUPSIZE;
+
+   if(matchEmpty(table->ctrl + group))
+   {
+      table->ctrl[i] = CTRL_EMPTY;
+      table->growthLeft++;
+   }
+   else
+      table->ctrl[i] = CTRL_DELETED;
+
+   table->freeFunc(table->slots[i].object);
+   freeKey(table, &table->slots[i]);
+   table->itemCount--;
+   migrateSlots(table, MIGRATE_GROUPS * GHASH_GROUPSIZE);
+
+   return true;
+}
+
+
+// isTextKeyed
+// String and span functions work on string and span tables.
+static bool isTextKeyed(gHashTable *table)
+{
+   return table->keyType == ghStringKeys || table->keyType == ghSpanKeys;
+}
+
+
+// gAddTableItem
+// Attempts to add the given object to the hash table. If the given key already exists
+// the function will return false. Otherwise returns true. The string passed will be
+// copied. The gHashTable will not free the string you pass to this function.
+bool gAddTableItem(gHashTable *table, const char *key, void *item)
+{
+   unsigned int len;
+
+   if(!table || !key || !isTextKeyed(table))
+      return false;
+
+   len = (unsigned int)strlen(key);
+   return addItem(table, key, len, table->hashFunc(key, len), item);
+}
+
+
+// gFindTableItem
+// Searches the hash table for the given key and returns a pointer to the associated
+// object (returns NULL on fail)
+void *gFindTableItem(gHashTable *table, const char *key)
+{
+   unsigned int len;
+
+   if(!table || !key || !isTextKeyed(table))
+      return NULL;
+
+   len = (unsigned int)strlen(key);
+   return findItem(table, key, len, table->hashFunc(key, len));
+}
+
+
+// gRemoveTableItem
+// Searches the hash table for the given key and removes it from the table. If 
+// the table is set to free objects, it will be freed. Returns true if the
+// key was found, or false if it was not.
+bool gRemoveTableItem(gHashTable *table, const char *key)
+{
+   unsigned int len;
+
+   if(!table || !key || !isTextKeyed(table))
+      return false;
+
+   len = (unsigned int)strlen(key);
+   return removeItem(table, key, len, table->hashFunc(key, len));
+}
+
+
+// gAddSpanItem
+// Adds an item under the first len chars of key.
+bool gAddSpanItem(gHashTable *table, const char *key, unsigned int len, void *item)
+{
+   if(!table || !key || !isTextKeyed(table))
+      return false;
+
+   return addItem(table, key, len, table->hashFunc(key, len), item);
+}
+
+
+// gFindSpanItem
+// Searches for the first len chars of key.
+void *gFindSpanItem(gHashTable *table, const char *key, unsigned int len)
+{
+   if(!table || !key || !isTextKeyed(table))
+      return NULL;
+
+   return findItem(table, key, len, table->hashFunc(key, len));
+}
+
+
+// gRemoveSpanItem
+// Removes the item stored under the first len chars of key.
+bool gRemoveSpanItem(gHashTable *table, const char *key, unsigned int len)
+{
+   if(!table || !key || !isTextKeyed(table))
+      return false;
+
+   return removeItem(table, key, len, table->hashFunc(key, len));
+}
+
+
+// gHashSpan
+// Hash that string and span tables use for the first len chars of key.
+unsigned int gHashSpan(const char *key, unsigned int len, bool ignoreCase)
+{
+   if(!key)
+      return 0;
+
+   return ignoreCase ? calcHashKey(key, len) : calcHashKeyS(key, len);
+}
+
+
+// gFindHashedItem
+// Searches for the first len chars of key, with the hash from gHashSpan.
+void *gFindHashedItem(gHashTable *table, const char *key, unsigned int len, unsigned int hash)
+{
+   if(!table || !key || !isTextKeyed(table))
+      return NULL;
+
+   return findItem(table, key, len, hash);
+}
+
+
+// gAddIntItem
+// Adds an item to an integer or pointer table.
+bool gAddIntItem(gHashTable *table, size_t key, void *item)
+{
+   if(!table || isTextKeyed(table))
+      return false;
+
+   return addItem(table, (const char *)key, 0, calcHashWord((const char *)key, 0), item);
+}
+
+
+// gFindIntItem
+// Searches an integer or pointer table.
+void *gFindIntItem(gHashTable *table, size_t key)
+{
+   if(!table || isTextKeyed(table))
+      return NULL;
+
+   return findItem(table, (const char *)key, 0, calcHashWord((const char *)key, 0));
+}
+
+
+// gRemoveIntItem
+// Removes an item from an integer or pointer table.
+bool gRemoveIntItem(gHashTable *table, size_t key)
+{
+   if(!table || isTextKeyed(table))
+      return false;
+
+   return removeItem(table, (const char *)key, 0, calcHashWord((const char *)key, 0));
+}
+
+
+// gAddPtrItem
+// Adds an item to a pointer table.
+bool gAddPtrItem(gHashTable *table, const void *key, void *item)
+{
+   return gAddIntItem(table, (size_t)key, item);
+}
+
+
+// gFindPtrItem
+// Searches a pointer table.
+void *gFindPtrItem(gHashTable *table, const void *key)
+{
+   return gFindIntItem(table, (size_t)key);
+}
+
+
+// gRemovePtrItem
+// Removes an item from a pointer table.
+bool gRemovePtrItem(gHashTable *table, const void *key)
+{
+   return gRemoveIntItem(table, (size_t)key);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// gSharedHashTable
+// Read-mostly table for sharing between threads. Readers load the current 
+// snapshot and search it without locking. Writers take the lock, build a 
+// changed copy and publish it. 
+//
+// Memory is reclaimed by epochs: every publish bumps the table's epoch, and
+// replaced snapshots and removed objects are tagged with the epoch they were
+// retired in. A registered reader stores the epoch it entered in, so nothing
+// retired before the oldest active reader's epoch can still be in use.
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION sharedLock;
+#define initLock(l)     InitializeCriticalSection(l)
+#define freeLock(l)     DeleteCriticalSection(l)
+#define lockShared(l)   EnterCriticalSection(l)
+#define unlockShared(l) LeaveCriticalSection(l)
+// Volatile accesses are acquire/release with MSVC, interlocked ones are 
+// full barriers.
+#define SHARED_LOAD(var)        (var)
+#define SHARED_STORE(var, val)  ((var) = (val))
+#define SHARED_SET(var, val)    InterlockedExchange((volatile LONG *)&(var), (LONG)(val))
+#define SHARED_INC(var)         InterlockedIncrement((volatile LONG *)&(var))
+#define SHARED_FENCE()          MemoryBarrier()
+#else
+typedef pthread_mutex_t sharedLock;
+#define initLock(l)     pthread_mutex_init(l, NULL)
+#define freeLock(l)     pthread_mutex_destroy(l)
+#define lockShared(l)   pthread_mutex_lock(l)
+#define unlockShared(l) pthread_mutex_unlock(l)
+#define SHARED_LOAD(var)        __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define SHARED_STORE(var, val)  __atomic_store_n(&(var), (val), __ATOMIC_RELEASE)
+#define SHARED_SET(var, val)    __atomic_store_n(&(var), (val), __ATOMIC_SEQ_CST)
+#define SHARED_INC(var)         __atomic_add_fetch(&(var), 1, __ATOMIC_SEQ_CST)
+#define SHARED_FENCE()          __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#endif
+
+#define SHARED_IDLE     0        // Epoch of a reader outside the table
+
+struct gSharedHashTable
+{
+   gHashTable * volatile current;   // Snapshot readers search
+   volatile unsigned long epoch;    // Bumped by every publish
+   void        (*freeFunc)(void *object);
+   sharedLock  lock;                // Held by writers
+   gList       *readers;            // Registered gSharedReaders
+   gList       *retired;            // Replaced snapshots, as sharedGarbage
+   gList       *removed;            // Removed objects, as sharedGarbage
+};
+
+struct gSharedReader
+{
+   gSharedHashTable        *shared;
+   volatile unsigned long  epoch;   // Epoch entered in, or SHARED_IDLE
+};
+
+typedef struct
+{
+   void           *object;
+   unsigned long  epoch;            // Epoch the object was retired in
+} sharedGarbage;
+
+
+// retireObject
+// Queues an object for freeing once no reader can reach it. The lock must 
+// be held.
+static void retireObject(gSharedHashTable *shared, gList *list, void *object)
+{
+   sharedGarbage *g = gAlloc(shared->current->allocator, sizeof(sharedGarbage));
+
+   g->object = object;
+   g->epoch = shared->epoch;
+   gAppendListItem(list, g);
+}
+
+
+// freeGarbage
+// Frees the queued objects retired before epoch. The lists are in retire 
+// order, so that's always a prefix. The lock must be held.
+static void freeGarbage(gSharedHashTable *shared, unsigned long epoch)
+{
+   const gAllocator  *allocator = shared->current->allocator;
+   sharedGarbage     *g;
+
+   while(gGetListSize(shared->retired) && ((sharedGarbage *)gGetListItem(shared->retired, 0))->epoch < epoch)
+   {
+      g = gPopListFront(shared->retired);
+      gFreeHashTable((gHashTable *)g->object);
+      gFree(allocator, g);
+   }
+
+   while(gGetListSize(shared->removed) && ((sharedGarbage *)gGetListItem(shared->removed, 0))->epoch < epoch)
+   {
+      g = gPopListFront(shared->removed);
+      shared->freeFunc(g->object);
+      gFree(allocator, g);
+   }
+}
+
+
+// oldestEpoch
+// Returns the oldest epoch an active reader entered in, or one past the 
+// current epoch if no reader is active. The lock must be held.
+static unsigned long oldestEpoch(gSharedHashTable *shared)
+{
+   unsigned long  ret = shared->epoch + 1, epoch;
+   int            i, count = gGetListSize(shared->readers);
+
+   // Pairs with the fence in gEnterShared: a reader not seen here will see
+   // the current snapshot.
+   SHARED_FENCE();
+
+   for(i = 0; i < count; i++)
+   {
+      epoch = SHARED_LOAD(((gSharedReader *)gGetListItem(shared->readers, i))->epoch);
+      if(epoch != SHARED_IDLE && epoch < ret)
+         ret = epoch;
+   }
+
+   return ret;
+}
+
+
+// copyTable
+// Returns a copy of table with room for one more item. The copy never frees
+// its objects.
+static gHashTable *copyTable(gHashTable *table)
+{
+   gHashTable     *ret = gNewKeyedHashTableEx(table->itemCount + 1, NULL, table->keyType, false, table->allocator);
+   gHashSlot      slot;
+   unsigned int   i;
+
+   ret->hashFunc = table->hashFunc;
+   ret->compFunc = table->compFunc;
+
+   for(i = 0; i < table->capacity; i++)
+   {
+      if(!(table->ctrl[i] & 0x80))
+      {
+         slot = table->slots[i];
+         if(ret->keyType == ghStringKeys)
+            slot.key = copyKey(ret, slot.key, slot.len);
+         placeSlot(ret, &slot);
+      }
+   }
+
+   for(i = table->migrated; i < table->oldCapacity; i++)
+   {
+      if(!(table->oldCtrl[i] & 0x80))
+      {
+         slot = table->oldSlots[i];
+         if(ret->keyType == ghStringKeys)
+            slot.key = copyKey(ret, slot.key, slot.len);
+         placeSlot(ret, &slot);
+      }
+   }
+
+   ret->itemCount = table->itemCount;
+   return ret;
+}
+
+
+// publishTable
+// Makes table the snapshot readers see, retiring the previous one. Once 
+// readers are registered, whatever none of them can reach is freed. The 
+// lock must be held.
+static void publishTable(gSharedHashTable *shared, gHashTable *table, void *removed)
+{
+   retireObject(shared, shared->retired, shared->current);
+   if(removed)
+      retireObject(shared, shared->removed, removed);
+
+   SHARED_STORE(shared->current, table);
+   SHARED_INC(shared->epoch);
+
+   if(gGetListSize(shared->readers))
+      freeGarbage(shared, oldestEpoch(shared));
+}
+
+
+// gShareHashTable
+// Turns a filled table into a shared table. The shared table takes over 
+// the table and the freeing of its objects.
+gSharedHashTable *gShareHashTable(gHashTable *table)
+{
+   gSharedHashTable *ret;
+
+   if(!table)
+      return NULL;
+
+   ret = gAlloc(table->allocator, sizeof(gSharedHashTable));
+   ret->freeFunc = table->freeFunc;
+   ret->epoch = SHARED_IDLE + 1;
+   ret->readers = gNewListEx(NULL, table->allocator);
+   ret->retired = gNewListEx(NULL, table->allocator);
+   ret->removed = gNewListEx(NULL, table->allocator);
+   initLock(&ret->lock);
+
+   // Snapshots only hold the objects; removed ones are freed on reclaim.
+   // Readers never migrate, so the table is settled before it's shared.
+   table->freeFunc = hashFreeNOP;
+   gFinishTableResize(table);
+   ret->current = table;
+
+   return ret;
+}
+
+
+// gFreeSharedHashTable
+// Frees a shared table with all of its snapshots, objects and readers. No 
+// thread can be using the table.
+void gFreeSharedHashTable(gSharedHashTable *shared)
+{
+   const gAllocator  *allocator;
+   int               i;
+
+   if(!shared)
+      return;
+
+   allocator = shared->current->allocator;
+
+   freeGarbage(shared, shared->epoch + 1);
+   shared->current->freeFunc = shared->freeFunc;
+   gFreeHashTable(shared->current);
+
+   for(i = 0; i < gGetListSize(shared->readers); i++)
+      gFree(allocator, gGetListItem(shared->readers, i));
+
+   gFreeList(shared->readers);
+   gFreeList(shared->retired);
+   gFreeList(shared->removed);
+   freeLock(&shared->lock);
+   gFree(allocator, shared);
+}
+
+
+// gAddSharedReader
+// Registers a reader thread.
+gSharedReader *gAddSharedReader(gSharedHashTable *shared)
+{
+   gSharedReader *ret;
+
+   if(!shared)
+      return NULL;
+
+   lockShared(&shared->lock);
+
+   ret = gAlloc(shared->current->allocator, sizeof(gSharedReader));
+   ret->shared = shared;
+   ret->epoch = SHARED_IDLE;
+   gAppendListItem(shared->readers, ret);
+
+   unlockShared(&shared->lock);
+   return ret;
+}
+
+
+// gRemoveSharedReader
+// Unregisters a reader that's outside the table.
+void gRemoveSharedReader(gSharedReader *reader)
+{
+   gSharedHashTable  *shared;
+   int               i;
+
+   if(!reader)
+      return;
+
+   shared = reader->shared;
+   lockShared(&shared->lock);
+
+   for(i = 0; i < gGetListSize(shared->readers); i++)
+   {
+      if(gGetListItem(shared->readers, i) == reader)
+      {
+         gSwapDeleteListItem(shared->readers, i);
+         break;
+      }
+   }
+
+   gFree(shared->current->allocator, reader);
+   unlockShared(&shared->lock);
+}
+
+
+// gEnterShared
+// Marks a reader as active in the current epoch. The fence orders the 
+// store before any load of the snapshot.
+void gEnterShared(gSharedReader *reader)
+{
+   if(!reader)
+      return;
+
+   SHARED_SET(reader->epoch, SHARED_LOAD(reader->shared->epoch));
+   SHARED_FENCE();
+}
+
+
+// gLeaveShared
+// Marks a reader as done with everything it found.
+void gLeaveShared(gSharedReader *reader)
+{
+   if(!reader)
+      return;
+
+   SHARED_STORE(reader->epoch, SHARED_IDLE);
+}
+
+
+// gFindSharedItem
+// Searches the current snapshot without locking.
+void *gFindSharedItem(gSharedHashTable *shared, const char *key)
+{
+   if(!shared)
+      return NULL;
+
+   return gFindTableItem(SHARED_LOAD(shared->current), key);
+}
+
+
+// gAddSharedItem
+// Publishes a copy of the table with the item added.
+bool gAddSharedItem(gSharedHashTable *shared, const char *key, void *item)
+{
+   gHashTable  *table;
+   bool        ret = false;
+
+   if(!shared || !key)
+      return false;
+
+   lockShared(&shared->lock);
+
+   if(!gFindTableItem(shared->current, key))
+   {
+      table = copyTable(shared->current);
+      gAddTableItem(table, key, item);
+      publishTable(shared, table, NULL);
+      ret = true;
+   }
+
+   unlockShared(&shared->lock);
+   return ret;
+}
+
+
+// gRemoveSharedItem
+// Publishes a copy of the table with the item removed. The object is freed
+// once no reader can hold it.
+bool gRemoveSharedItem(gSharedHashTable *shared, const char *key)
+{
+   gHashTable  *table;
+   void        *object;
+   bool        ret = false;
+
+   if(!shared || !key)
+      return false;
+
+   lockShared(&shared->lock);
+
+   if((object = gFindTableItem(shared->current, key)) != NULL)
+   {
+      table = copyTable(shared->current);
+      gRemoveTableItem(table, key);
+      publishTable(shared, table, object);
+      ret = true;
+   }
+
+   unlockShared(&shared->lock);
+   return ret;
+}
+
+
+// gReclaimSharedTable
+// Frees replaced snapshots and removed objects that were retired before 
+// the oldest active reader entered.
+void gReclaimSharedTable(gSharedHashTable *shared)
+{
+   if(!shared)
+      return;
+
+   lockShared(&shared->lock);
+   freeGarbage(shared, oldestEpoch(shared));
+   unlockShared(&shared->lock);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// gStaticHashTable
+// Immutable table with a minimal perfect hash, built with hash and displace:
+// keys are split into buckets by hash, and each bucket (biggest first) gets 
+// a displacement that moves all of its keys to free slots. Buckets of one 
+// key store their slot directly. A lookup is one hash, one displacement, 
+// one slot and one compare. Everything lives in one block.
+
+#define STATIC_DIRECT     0x80000000u   // Displacement is a slot index
+#define STATIC_KEYS       4             // Average keys per bucket
+#define STATIC_MAXDISP    65536         // Displacements tried per bucket
+#define STATIC_MAXSEEDS   16            // Hash seeds tried before giving up
+
+typedef struct
+{
+   const char     *key;
+   unsigned int   len;
+   void           *value;
+} gStaticSlot;
+
+struct gStaticHashTable
+{
+   const gAllocator *allocator;
+   unsigned int   count;      // Number of keys and slots
+   unsigned int   nbuckets;
+   unsigned int   seed;       // Basis of the key hash
+   bool           ignoreCase;
+   gStaticSlot    *slots;
+   unsigned int   *disp;      // Displacement of each bucket
+};
+
+
+// staticHash
+// Hashes a key with the table's seed.
+static unsigned int staticHash(const char *key, unsigned int len, bool ignoreCase, unsigned int seed)
+{
+   const unsigned char *c = (const unsigned char *)key, *end = c + len;
+   unsigned h = 2166136261u ^ (seed * 0x9E3779B9u);
+
+   if(ignoreCase)
+   {
+      for(; c < end; c++)
+         h = (h ^ toupper(*c)) * 16777619u;
+   }
+   else
+   {
+      for(; c < end; c++)
+         h = (h ^ *c) * 16777619u;
+   }
+
+   return mixHash(h);
+}
+
+
+// staticSlot
+// Slot of a key with hash h in a bucket with displacement d.
+static unsigned int staticSlot(unsigned int h, unsigned int d, unsigned int count)
+{
+   if(d & STATIC_DIRECT)
+      return d & ~STATIC_DIRECT;
+
+   return mixHash(h ^ (d * 0x85EBCA6Bu + 0x68E31DA4u)) % count;
+}
+
+
+// placeBuckets
+// Finds displacements for all buckets with the given seed. order holds the
+// keys sorted by bucket, starting at first[bucket]. Returns false if some 
+// bucket can't be placed.
+static bool placeBuckets(gStaticHashTable *table, const unsigned int *hashes, const unsigned int *order,
+                         const unsigned int *first, const unsigned int *bysize, unsigned char *taken, unsigned int *pos)
+{
+   unsigned int b, k, d, j, next = 0;
+
+   memset(taken, 0, table->count);
+
+   for(b = 0; b < table->nbuckets; b++)
+   {
+      unsigned int bucket = bysize[b], size = first[bucket + 1] - first[bucket];
+      const unsigned int *keys = order + first[bucket];
+
+      if(size == 0)
+      {
+         table->disp[bucket] = 0;
+         continue;
+      }
+
+      // Single keys go straight into the next free slot.
+      if(size == 1)
+      {
+         while(taken[next])
+            next++;
+
+         taken[next] = 1;
+         pos[keys[0]] = next;
+         table->disp[bucket] = STATIC_DIRECT | next;
+         continue;
+      }
+
+      for(d = 0; d < STATIC_MAXDISP; d++)
+      {
+         for(k = 0; k < size; k++)
+         {
+            pos[keys[k]] = staticSlot(hashes[keys[k]], d, table->count);
+
+            if(taken[pos[keys[k]]])
+               break;
+
+            // Keys of the same bucket may also collide with each other.
+            for(j = 0; j < k && pos[keys[j]] != pos[keys[k]]; j++)
+               ;
+            if(j < k)
+               break;
+         }
+
+         if(k == size)
+            break;
+      }
+
+      if(d == STATIC_MAXDISP)
+         return false;
+
+      for(k = 0; k < size; k++)
+         taken[pos[keys[k]]] = 1;
+
+      table->disp[bucket] = d;
+   }
+
+   return true;
+}
+
+
+// gBuildStaticHashTable
+// Builds an immutable case sensitive table from the given keys and values.
+gStaticHashTable *gBuildStaticHashTable(const char **keys, void **values, unsigned int n)
+{
+   return gBuildStaticHashTableEx(keys, values, n, false, NULL);
+}
+
+
+// gBuildStaticHashTableEx
+// Builds an immutable table from the given keys and values. Later copies of
+// a key are ignored, like gAddTableItem does.
+gStaticHashTable *gBuildStaticHashTableEx(const char **keys, void **values, unsigned int n, 
+                                          bool ignoreCase, const gAllocator *allocator)
+{
+   gStaticHashTable  *ret = NULL;
+   gHashTable        *seen;
+   unsigned int      *lens, *unique, *hashes, *order, *first, *bysize, *pos;
+   unsigned char     *taken;
+   unsigned int      i, b, s, count = 0, nbuckets, maxsize, seed;
+   size_t            strbytes = 0, size;
+   char              *strings;
+
+   if(!keys || !values)
+      return NULL;
+
+   if(!allocator)
+      allocator = gGetAllocator();
+
+   // Drop duplicate keys.
+   lens = gAlloc(allocator, sizeof(unsigned int) * (n + 1));
+   unique = gAlloc(allocator, sizeof(unsigned int) * (n + 1));
+   seen = gNewKeyedHashTableEx(n + 1, NULL, ghSpanKeys, ignoreCase, allocator);
+
+   for(i = 0; i < n; i++)
+   {
+      lens[i] = (unsigned int)strlen(keys[i]);
+
+      if(gAddSpanItem(seen, keys[i], lens[i], (void *)keys[i]))
+      {
+         unique[count++] = i;
+         strbytes += lens[i] + 1;
+      }
+   }
+
+   gFreeHashTable(seen);
+
+   nbuckets = count / STATIC_KEYS + 1;
+
+   // Slots come first so they are aligned, then displacements and strings.
+   size = sizeof(gStaticHashTable) + sizeof(gStaticSlot) * count + sizeof(unsigned int) * nbuckets + strbytes;
+   ret = gAlloc(allocator, size);
+   ret->allocator = allocator;
+   ret->count = count;
+   ret->nbuckets = nbuckets;
+   ret->ignoreCase = ignoreCase;
+   ret->slots = (gStaticSlot *)(ret + 1);
+   ret->disp = (unsigned int *)(ret->slots + count);
+   strings = (char *)(ret->disp + nbuckets);
+
+   hashes = gAlloc(allocator, sizeof(unsigned int) * (count + 1));
+   order = gAlloc(allocator, sizeof(unsigned int) * (count + 1));
+   pos = gAlloc(allocator, sizeof(unsigned int) * (count + 1));
+   first = gAlloc(allocator, sizeof(unsigned int) * (nbuckets + 1));
+   bysize = gAlloc(allocator, sizeof(unsigned int) * nbuckets);
+   taken = gAlloc(allocator, count + 1);
+
+   for(seed = 0; seed < STATIC_MAXSEEDS; seed++)
+   {
+      ret->seed = seed;
+
+      // Counting sort of the keys by bucket.
+      memset(first, 0, sizeof(unsigned int) * (nbuckets + 1));
+      for(i = 0; i < count; i++)
+      {
+         hashes[i] = staticHash(keys[unique[i]], lens[unique[i]], ignoreCase, seed);
+         first[hashes[i] % nbuckets + 1]++;
+      }
+
+      for(b = 0, maxsize = 0; b < nbuckets; b++)
+      {
+         if(first[b + 1] > maxsize)
+            maxsize = first[b + 1];
+         first[b + 1] += first[b];
+      }
+
+      // bysize is the fill cursor of each bucket for now.
+      memcpy(bysize, first, sizeof(unsigned int) * nbuckets);
+      for(i = 0; i < count; i++)
+         order[bysize[hashes[i] % nbuckets]++] = i;
+
+      // Biggest buckets first, they are the hardest to place.
+      for(i = 0, s = maxsize + 1; s-- > 0; )
+      {
+         for(b = 0; b < nbuckets; b++)
+         {
+            if(first[b + 1] - first[b] == s)
+               bysize[i++] = b;
+         }
+      }
+
+      if(placeBuckets(ret, hashes, order, first, bysize, taken, pos))
+         break;
+   }
+
+   if(seed < STATIC_MAXSEEDS)
+   {
+      for(i = 0; i < count; i++)
+      {
+         gStaticSlot *slot = &ret->slots[pos[i]];
+
+         memcpy(strings, keys[unique[i]], lens[unique[i]] + 1);
+         slot->key = strings;
+         slot->len = lens[unique[i]];
+         slot->value = values[unique[i]];
+         strings += slot->len + 1;
+      }
+   }
+   else
+   {
+      gFree(allocator, ret);
+      ret = NULL;
+   }
+
+   gFree(allocator, lens);
+   gFree(allocator, unique);
+   gFree(allocator, hashes);
+   gFree(allocator, order);
+   gFree(allocator, pos);
+   gFree(allocator, first);
+   gFree(allocator, bysize);
+   gFree(allocator, taken);
+
+   return ret;
+}
+
+
+// gFreeStaticHashTable
+// Frees the table; the values are not touched.
+void gFreeStaticHashTable(gStaticHashTable *table)
+{
+   if(table)
+      gFree(table->allocator, table);
+}
+
+
+// gGetStaticTableSize
+// Number of distinct keys in the table.
+unsigned int gGetStaticTableSize(gStaticHashTable *table)
+{
+   return table ? table->count : 0;
+}
+
+
+// gFindStaticSpanItem
+// Looks up the first len chars of key.
+void *gFindStaticSpanItem(gStaticHashTable *table, const char *key, unsigned int len)
+{
+   const gStaticSlot *slot;
+   unsigned int      h;
+
+   if(!table || !key || !table->count)
+      return NULL;
+
+   h = staticHash(key, len, table->ignoreCase, table->seed);
+   slot = &table->slots[staticSlot(h, table->disp[h % table->nbuckets], table->count)];
+
+   if(slot->len != len)
+      return NULL;
+
+   if(table->ignoreCase ? _strnicmp(slot->key, key, len) : memcmp(slot->key, key, len))
+      return NULL;
+
+   return slot->value;
+}
+
+
+// gFindStaticItem
+// Looks up a NUL terminated key.
+void *gFindStaticItem(gStaticHashTable *table, const char *key)
+{
+   return key ? gFindStaticSpanItem(table, key, (unsigned int)strlen(key)) : NULL;
+}
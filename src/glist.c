@@ -41,6 +41,35 @@
 void gFreeNOP(void *object) {}
 
 
+// Lists start out in their small buffer and only go to the heap once they
+// outgrow it.
+//
+// Removing items from the front only moves list forward within the storage
+// starting at base. The gap is closed again once it's at least as big as 
+// the items, so each item is moved at most once per trip through the list.
+static bool isSmall(gList *l)
+{
+   return l->base == l->small;
+}
+
+
+// Free storage in front of the items.
+static unsigned int frontRoom(gList *l)
+{
+   return (unsigned int)(l->list - l->base);
+}
+
+
+// compactList
+// Moves the items back to the start of the storage.
+static void compactList(gList *l)
+{
+   if(l->list == l->base)
+      return;
+
+   memmove(l->base, l->list, sizeof(void *) * l->size);
+   l->list = l->base;
+}
 
 
 void gInitList(gList *list, void (*freeFunc)(void *))
@@ -51,15 +80,27 @@ void gInitList(gList *list, void (*freeFunc)(void *))
       list->freeFunc = freeFunc;
    else
       list->freeFunc = gFreeNOP;
+
+   list->allocator = gGetAllocator();
+   list->list = list->base = list->small;
+   list->max = GLIST_SMALLSIZE;
 }
 
 
 gList *gNewList(void (*freeFunc)(void *))
 {
-   gList *ret = (gList *)malloc(sizeof(gList));
+   return gNewListEx(freeFunc, NULL);
+}
+
+
+gList *gNewListEx(void (*freeFunc)(void *), const gAllocator *allocator)
+{
+   gList *ret = (gList *)gAlloc(allocator, sizeof(gList));
 
    gInitList(ret, freeFunc);
 
+   if(allocator)
+      ret->allocator = allocator;
    ret->freestruct = true;
 
    return ret;
@@ -80,11 +121,11 @@ void gFreeList(gList *l)
          l->freeFunc(l->list[i]);
    }
 
-   if(l->list)
-      free(l->list);
+   if(l->base && !isSmall(l))
+      gFree(l->allocator, l->base);
 
    if(l->freestruct)
-      free(l);
+      gFree(l->allocator, l);
    else
       memset(l, 0, sizeof(*l));
 }
@@ -102,32 +143,65 @@ void gClearList(gList *l)
    for(i = 0; i < l->size; i++)
    {
       if(l->list[i])
-      {
          l->freeFunc(l->list[i]);
-         l->list[i] = NULL;
-      }
    }
 
    l->size = 0;
+   l->list = l->base;
 }
 
 
 
-
-static void checkListSize(gList *l, unsigned int newsize)
+// setListMax
+// Moves the items to the start of storage for exactly newmax pointers, 
+// which is the small buffer if they fit.
+static void setListMax(gList *l, unsigned int newmax)
 {
-   if(newsize >= l->max)
-   {
-      unsigned int newalloc = newsize * 2;
-      unsigned int i;
+   void **newlist;
 
-      l->list = (void **)realloc(l->list, sizeof(void *) * newalloc);
+   compactList(l);
 
-      for(i = l->size; i < newalloc; i++)
-         l->list[i] = NULL;
+   if(newmax <= GLIST_SMALLSIZE)
+   {
+      if(isSmall(l))
+         return;
 
-      l->max = newalloc;
+      memcpy(l->small, l->base, sizeof(void *) * l->size);
+      gFree(l->allocator, l->base);
+      l->list = l->base = l->small;
+      l->max = GLIST_SMALLSIZE;
+      return;
    }
+
+   if(isSmall(l))
+   {
+      newlist = (void **)gAlloc(l->allocator, sizeof(void *) * newmax);
+      memcpy(newlist, l->small, sizeof(void *) * l->size);
+   }
+   else
+      newlist = (void **)gRealloc(l->allocator, l->base, sizeof(void *) * newmax);
+
+   l->list = l->base = newlist;
+   l->max = newmax;
+}
+
+
+
+// checkListSize
+// Makes room for newsize items from list on.
+static void checkListSize(gList *l, unsigned int newsize)
+{
+   unsigned int front = frontRoom(l);
+
+   if(newsize <= l->max - front)
+      return;
+
+   // Close the gap if that makes enough room and the gap is big enough to
+   // pay for moving the items.
+   if(newsize <= l->max && front >= l->size)
+      compactList(l);
+   else
+      setListMax(l, newsize > l->max * 2 ? newsize : l->max * 2);
 }
 
 
@@ -148,25 +222,10 @@ void gAppendListItem(gList *l, void *object)
 
 void gInsertListItem(gList *l, void *object, unsigned int toindex)
 {
-   unsigned int i;
-
    if(!l || !object)
       return;
 
-   // Clip index
-   if(toindex < 0)
-      toindex = 0;
-   if(toindex > l->size)
-      toindex = l->size; 
-
-   checkListSize(l, l->size + 1);
-
-   // Push strings one item to the right.
-   for(i = l->size; i > toindex; i--)
-      l->list[i] = l->list[i - 1];
-
-   l->size++;
-   l->list[toindex] = object;
+   gInsertListItems(l, toindex, &object, 1);
 }
 
 
@@ -190,25 +249,20 @@ void *gGetListItem(gList *l, unsigned int index)
 
 void gDeleteListItem(gList *l, unsigned int index)
 {
-   unsigned int i;
-
    if(index >= l->size)
       return;
 
-   l->freeFunc(l->list[index]);
-
-   for(i = index; (i + 1) < l->size; i++)
-      l->list[i] = l->list[i + 1];
-
-   l->list[i] = NULL;
-   l->size--;
+   gDeleteListRange(l, index, index);
 }
 
 
 
 void gDeleteListRange(gList *l, unsigned int first, unsigned int last)
 {
-   unsigned int i, q, offset;
+   unsigned int i, count;
+
+   if(!l || first >= l->size)
+      return;
 
    if(last >= l->size)
       last = l->size - 1;
@@ -216,27 +270,26 @@ void gDeleteListRange(gList *l, unsigned int first, unsigned int last)
    if(first > last)
       return;
 
-   offset = last - first + 1;
+   count = last - first + 1;
    
    for(i = first; i <= last; i++)
-   {
       l->freeFunc(l->list[i]);
 
-      q = i + offset;
+   // Items at the front are dropped by moving the start of the list.
+   if(first == 0)
+      l->list += count;
+   else
+      memmove(l->list + first, l->list + last + 1, sizeof(void *) * (l->size - last - 1));
 
-      if(q >= l->size)
-         l->list[i] = NULL;
-      else
-         l->list[i] = l->list[q];
-   }
+   l->size -= count;
 
-   l->size -= offset;
+   if(!l->size)
+      l->list = l->base;
 }
 
 
 void gMoveListItem(gList *l, unsigned int index, unsigned int newindex)
 {
-   unsigned int   i;
    void     *tmp;
 
    if(!l)
@@ -254,15 +307,9 @@ void gMoveListItem(gList *l, unsigned int index, unsigned int newindex)
    tmp = l->list[index];
 
    if(index < newindex)
-   {
-      for(i = index; i < newindex; i++)
-         l->list[i] = l->list[i + 1];
-   }
+      memmove(l->list + index, l->list + index + 1, sizeof(void *) * (newindex - index));
    else
-   {
-      for(i = index; i > newindex; i--)
-         l->list[i] = l->list[i - 1];
-   }
+      memmove(l->list + newindex + 1, l->list + newindex, sizeof(void *) * (index - newindex));
 
    l->list[newindex] = tmp;
 }
@@ -272,28 +319,56 @@ void gMoveListItem(gList *l, unsigned int index, unsigned int newindex)
 
 void gTrimUnusedList(gList *l)
 {
-   void *newlist;
-   unsigned newsize = l->size + 1;
-
-   if(newsize >= l->max)
+   if(!l || !l->base || l->size >= l->max)
       return; // Needs no trimming
 
-   newlist = malloc(sizeof(void *) * newsize);
-   memcpy(newlist, l->list, sizeof(void *) * newsize);
+   setListMax(l, l->size);
+}
+
+
+
+void gReserveList(gList *l, unsigned int count)
+{
+   if(!l)
+      return;
 
-   free(l->list);
-   l->list = newlist;
-   l->max = newsize;
+   checkListSize(l, count);
 }
 
 
 
-bool gMoveListItems(gList *src, unsigned int srcindex, gList *dest, unsigned int count)
+void gInsertListItems(gList *l, unsigned int toindex, void **objects, unsigned int count)
 {
-   unsigned int destindex = dest->size;
-   unsigned int newsrcsize, newdestsize;
+   if(!l || !objects || !count)
+      return;
+
+   // Clip index
+   if(toindex > l->size)
+      toindex = l->size; 
 
-   if(!dest || !src || !count)
+   checkListSize(l, l->size + count);
+
+   memmove(l->list + toindex + count, l->list + toindex, sizeof(void *) * (l->size - toindex));
+   memcpy(l->list + toindex, objects, sizeof(void *) * count);
+   l->size += count;
+}
+
+
+
+void gSwapDeleteListItem(gList *l, unsigned int index)
+{
+   if(!l || index >= l->size)
+      return;
+
+   l->freeFunc(l->list[index]);
+   l->list[index] = l->list[--l->size];
+}
+
+
+
+bool gSpliceList(gList *dest, unsigned int destindex, gList *src, unsigned int srcindex, unsigned int count)
+{
+   if(!dest || !src || !count || dest == src)
       return false;
 
    if(srcindex >= src->size)
@@ -302,20 +377,63 @@ bool gMoveListItems(gList *src, unsigned int srcindex, gList *dest, unsigned int
    if(srcindex + count > src->size)
       count = src->size - srcindex;
 
-   newsrcsize = src->size - count;
-   newdestsize = dest->size + count;
+   gInsertListItems(dest, destindex, src->list + srcindex, count);
 
-   checkListSize(dest, newdestsize);
+   memmove(src->list + srcindex, src->list + srcindex + count, sizeof(void *) * (src->size - srcindex - count));
+   src->size -= count;
 
-   memcpy(dest->list + destindex, src->list + srcindex, sizeof(void *) * count);
+   return true;
+}
 
-   if(srcindex + count < src->size)
-      memmove(src->list + srcindex, src->list + srcindex + count, srcindex + count - src->size);
 
-   memset(src->list + newsrcsize, 0, src->size - newsrcsize);
 
-   src->size -= count;
-   dest->size += count;
+bool gMoveListItems(gList *src, unsigned int srcindex, gList *dest, unsigned int count)
+{
+   if(!dest)
+      return false;
 
-   return true;
-}
\ No newline at end of file
+   return gSpliceList(dest, dest->size, src, srcindex, count);
+}
+
+
+
+void *gPopListFront(gList *l)
+{
+   void *ret;
+
+   if(!l || !l->size)
+      return NULL;
+
+   ret = *l->list++;
+
+   if(!--l->size)
+      l->list = l->base;
+
+   return ret;
+}
+
+
+
+void gPushListFront(gList *l, void *object)
+{
+   unsigned int shift;
+
+   if(!l || !object)
+      return;
+
+   if(!frontRoom(l))
+   {
+      // Grow unless at least half the size of the list is free, then move
+      // the items to the middle of the free room.
+      if(l->max - l->size < l->size / 2 + 1)
+         setListMax(l, (l->size + 1) * 2);
+
+      compactList(l);
+      shift = (l->max - l->size + 1) / 2;
+      memmove(l->base + shift, l->base, sizeof(void *) * l->size);
+      l->list = l->base + shift;
+   }
+
+   *--l->list = object;
+   l->size++;
+}
@@ -0,0 +1,526 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include "gparsefiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+
+// ----------------------------------------------------------------------------
+// Worker arenas
+// Each worker allocates from chunks of its own. Blocks carry their size for 
+// realloc. Freeing only gives memory back if the block was the last one 
+// allocated; the rest is reclaimed when the arena is reset after each file.
+
+#define ARENA_ALIGN     8
+#define ARENA_CHUNKSIZE 65536
+#define ALIGNUP(n)      (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define BLOCK_HEADER    ALIGNUP(sizeof(size_t))
+#define CHUNK_HEADER    ALIGNUP(sizeof(arenaChunk))
+
+typedef struct arenaChunk
+{
+   struct arenaChunk *next;
+   size_t            size;    // Bytes of data after the header
+   size_t            used;
+} arenaChunk;
+
+typedef struct
+{
+   gAllocator  allocator;     // Points back to the arena
+   arenaChunk  *chunks;       // Current chunk first
+} workerArena;
+
+
+static char *chunkData(arenaChunk *chunk)
+{
+   return (char *)chunk + CHUNK_HEADER;
+}
+
+
+static void *arenaAlloc(void *context, size_t size)
+{
+   workerArena *arena = (workerArena *)context;
+   arenaChunk  *chunk = arena->chunks;
+   size_t      need = BLOCK_HEADER + ALIGNUP(size);
+   char        *block;
+
+   if(!chunk || chunk->used + need > chunk->size)
+   {
+      size_t csize = need > ARENA_CHUNKSIZE ? need : ARENA_CHUNKSIZE;
+
+      if(!(chunk = (arenaChunk *)malloc(CHUNK_HEADER + csize)))
+         return NULL;
+
+      chunk->size = csize;
+      chunk->used = 0;
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+   }
+
+   block = chunkData(chunk) + chunk->used;
+   *(size_t *)block = size;
+   chunk->used += need;
+
+   return block + BLOCK_HEADER;
+}
+
+
+// isLastBlock
+// Returns true if ptr is the most recent block of the current chunk.
+static bool isLastBlock(workerArena *arena, void *ptr)
+{
+   arenaChunk  *chunk = arena->chunks;
+   size_t      size = *(size_t *)((char *)ptr - BLOCK_HEADER);
+
+   return chunk && (char *)ptr + ALIGNUP(size) == chunkData(chunk) + chunk->used;
+}
+
+
+static void *arenaRealloc(void *context, void *ptr, size_t size)
+{
+   workerArena *arena = (workerArena *)context;
+   size_t      *header, old;
+   void        *ret;
+
+   if(!ptr)
+      return arenaAlloc(context, size);
+
+   header = (size_t *)((char *)ptr - BLOCK_HEADER);
+   old = *header;
+
+   if(size <= old)
+      return ptr;
+
+   // The last block can grow in place.
+   if(isLastBlock(arena, ptr) && arena->chunks->used + ALIGNUP(size) - ALIGNUP(old) <= arena->chunks->size)
+   {
+      arena->chunks->used += ALIGNUP(size) - ALIGNUP(old);
+      *header = size;
+      return ptr;
+   }
+
+   if((ret = arenaAlloc(context, size)) != NULL)
+      memcpy(ret, ptr, old);
+
+   return ret;
+}
+
+
+static void arenaFree(void *context, void *ptr)
+{
+   workerArena *arena = (workerArena *)context;
+
+   if(ptr && isLastBlock(arena, ptr))
+      arena->chunks->used -= BLOCK_HEADER + ALIGNUP(*(size_t *)((char *)ptr - BLOCK_HEADER));
+}
+
+
+// resetArena
+// Empties the arena, keeping one chunk of the standard size for the next file.
+static void resetArena(workerArena *arena, bool keep)
+{
+   arenaChunk *chunk, *next, *kept = NULL;
+
+   for(chunk = arena->chunks; chunk; chunk = next)
+   {
+      next = chunk->next;
+
+      if(keep && !kept && chunk->size == ARENA_CHUNKSIZE)
+      {
+         kept = chunk;
+         kept->used = 0;
+         kept->next = NULL;
+      }
+      else
+         free(chunk);
+   }
+
+   arena->chunks = kept;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Work queues
+// Every worker has a queue of file indices, largest file first. A worker 
+// takes from the front of its own queue and steals from the back of the 
+// others. The queues are only filled before the workers start.
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION queueLock;
+#define initLock(l)     InitializeCriticalSection(l)
+#define freeLock(l)     DeleteCriticalSection(l)
+#define lockQueue(l)    EnterCriticalSection(l)
+#define unlockQueue(l)  LeaveCriticalSection(l)
+#else
+typedef pthread_mutex_t queueLock;
+#define initLock(l)     pthread_mutex_init(l, NULL)
+#define freeLock(l)     pthread_mutex_destroy(l)
+#define lockQueue(l)    pthread_mutex_lock(l)
+#define unlockQueue(l)  pthread_mutex_unlock(l)
+#endif
+
+typedef struct
+{
+   queueLock   lock;
+   int         *files;
+   int         first, last;   // Files left are files[first] to files[last - 1]
+} workQueue;
+
+typedef struct parseJob parseJob;
+
+typedef struct
+{
+   parseJob    *job;
+   int         index;
+   workerArena arena;
+
+   bool        started;       // Set if thread was created and has to be joined
+#ifdef _WIN32
+   HANDLE      thread;
+#else
+   pthread_t   thread;
+#endif
+} parseWorker;
+
+// Diagnostics of a file, kept until they are merged.
+typedef struct
+{
+   gParseResult   result;
+   gDiagBuffer    diagnostics;
+} fileResult;
+
+struct parseJob
+{
+   const char           **paths;
+   const gCompiledParms *cparms;
+   tpStep               *stepList;
+   const gParseHooks    *hooks;
+
+   workQueue            *queues;
+   parseWorker          *workers;
+   int                  nworkers;
+
+   fileResult           *results;
+};
+
+
+static int takeFile(parseJob *job, int worker)
+{
+   workQueue   *q = &job->queues[worker];
+   int         i, ret = -1;
+
+   lockQueue(&q->lock);
+   if(q->first < q->last)
+      ret = q->files[q->first++];
+   unlockQueue(&q->lock);
+
+   for(i = 1; ret < 0 && i < job->nworkers; i++)
+   {
+      q = &job->queues[(worker + i) % job->nworkers];
+
+      lockQueue(&q->lock);
+      if(q->first < q->last)
+         ret = q->files[--q->last];
+      unlockQueue(&q->lock);
+   }
+
+   return ret;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Workers
+
+// parseFile
+// Parses one file and copies its diagnostics out of the worker's arena.
+static void parseFile(parseJob *job, parseWorker *worker, int index)
+{
+   fileResult        *fr = &job->results[index];
+   const char        *path = job->paths[index];
+   const gAllocator  *allocator = &worker->arena.allocator;
+   gTextStream       *text;
+   gTokenStream      *ts;
+   tPattern          *p;
+   int               i;
+
+   gInitDiagnostics(&fr->diagnostics);
+
+   if(!(text = gStreamFromFilename(path)))
+   {
+      fr->result.result = tpFatal;
+      fr->result.ecount = 1;
+      gAddDiagnostic(&fr->diagnostics, gdCannotOpen, gdFatal, path, 0, 0, NULL, NULL, 0, 0);
+      return;
+   }
+
+   ts = gCreateCompiledTokenStreamEx(job->cparms, text, path, allocator);
+   p = tpNewPatternEx(job->stepList, ts, allocator);
+
+   if(job->hooks && job->hooks->begin)
+      job->hooks->begin(p, index, job->hooks->context);
+
+   fr->result.result = tpExecutePattern(p);
+   fr->result.ecount = p->ecount;
+   fr->result.wcount = p->wcount;
+
+   if(job->hooks && job->hooks->end)
+      job->hooks->end(p, index, fr->result.result, job->hooks->context);
+
+   for(i = 0; i < ts->diagnostics.count; i++)
+   {
+      const gDiagnostic *d = &ts->diagnostics.list[i];
+      gAddDiagnostic(&fr->diagnostics, d->code, d->severity, path, d->linenum, d->charnum, 
+                     d->sarg[0], d->sarg[1], d->iarg[0], d->iarg[1]);
+   }
+
+   // tpFreePattern frees the token stream.
+   tpFreePattern(p);
+   gFreeStream(text);
+
+   resetArena(&worker->arena, true);
+}
+
+
+static void runWorker(parseWorker *worker)
+{
+   int index;
+
+   while((index = takeFile(worker->job, worker->index)) >= 0)
+      parseFile(worker->job, worker, index);
+}
+
+
+#ifdef _WIN32
+static unsigned __stdcall workerThread(void *data)
+{
+   runWorker((parseWorker *)data);
+   return 0;
+}
+#else
+static void *workerThread(void *data)
+{
+   runWorker((parseWorker *)data);
+   return NULL;
+}
+#endif
+
+
+static int processorCount(void)
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+
+   GetSystemInfo(&info);
+   return (int)info.dwNumberOfProcessors;
+#else
+   long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+   return n > 0 ? (int)n : 1;
+#endif
+}
+
+
+static long fileSize(const char *path)
+{
+   FILE *f = fopen(path, "rb");
+   long size;
+
+   if(!f)
+      return 0;
+
+   fseek(f, 0, SEEK_END);
+   size = ftell(f);
+   fclose(f);
+
+   return size;
+}
+
+
+// Sorts (size, index) pairs largest first, ties in input order.
+static int compareSizes(const void *a, const void *b)
+{
+   const long *x = (const long *)a, *y = (const long *)b;
+
+   if(x[0] != y[0])
+      return x[0] > y[0] ? -1 : 1;
+
+   return x[1] < y[1] ? -1 : (x[1] > y[1]);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// gParseFiles
+
+int gParseFiles(const char **paths, int count, const gCompiledParms *cparms, tpStep *stepList, 
+                const gParseHooks *hooks, int nthreads, gParseResult *results, gDiagBuffer *diagnostics)
+{
+   parseJob    job;
+   long        *order;
+   int         i, j, ret = tpNoError;
+
+   if(!paths || count <= 0 || !cparms || !stepList)
+      return tpNoError;
+
+   if(nthreads <= 0)
+      nthreads = processorCount();
+   if(nthreads > count)
+      nthreads = count;
+
+   memset(&job, 0, sizeof(job));
+   job.paths = paths;
+   job.cparms = cparms;
+   job.stepList = stepList;
+   job.hooks = hooks;
+   job.nworkers = nthreads;
+   job.results = (fileResult *)gAlloc(NULL, sizeof(fileResult) * count);
+   job.queues = (workQueue *)gAlloc(NULL, sizeof(workQueue) * nthreads);
+   job.workers = (parseWorker *)gAlloc(NULL, sizeof(parseWorker) * nthreads);
+
+   memset(job.results, 0, sizeof(fileResult) * count);
+   memset(job.workers, 0, sizeof(parseWorker) * nthreads);
+
+   // Largest files first, dealt out to the workers in turn.
+   order = (long *)gAlloc(NULL, sizeof(long) * 2 * count);
+   for(i = 0; i < count; i++)
+   {
+      order[i * 2] = fileSize(paths[i]);
+      order[i * 2 + 1] = i;
+   }
+   qsort(order, count, sizeof(long) * 2, compareSizes);
+
+   for(i = 0; i < nthreads; i++)
+   {
+      workQueue *q = &job.queues[i];
+
+      initLock(&q->lock);
+      q->files = (int *)gAlloc(NULL, sizeof(int) * (count / nthreads + 1));
+      q->first = q->last = 0;
+
+      for(j = i; j < count; j += nthreads)
+         q->files[q->last++] = (int)order[j * 2 + 1];
+   }
+
+   gFree(NULL, order);
+
+   // Start the workers. The calling thread is worker 0.
+   for(i = 0; i < nthreads; i++)
+   {
+      parseWorker *w = &job.workers[i];
+
+      w->job = &job;
+      w->index = i;
+      w->arena.allocator.alloc = arenaAlloc;
+      w->arena.allocator.realloc = arenaRealloc;
+      w->arena.allocator.free = arenaFree;
+      w->arena.allocator.context = &w->arena;
+   }
+
+   // A worker that fails to start just leaves its queue to be stolen by the
+   // others, worker 0 at least.
+   for(i = 1; i < nthreads; i++)
+   {
+#ifdef _WIN32
+      job.workers[i].thread = (HANDLE)_beginthreadex(NULL, 0, workerThread, &job.workers[i], 0, NULL);
+      job.workers[i].started = job.workers[i].thread != 0;
+#else
+      job.workers[i].started = pthread_create(&job.workers[i].thread, NULL, workerThread, &job.workers[i]) == 0;
+#endif
+   }
+
+   runWorker(&job.workers[0]);
+
+   for(i = 1; i < nthreads; i++)
+   {
+      if(!job.workers[i].started)
+         continue;
+
+#ifdef _WIN32
+      WaitForSingleObject(job.workers[i].thread, INFINITE);
+      CloseHandle(job.workers[i].thread);
+#else
+      pthread_join(job.workers[i].thread, NULL);
+#endif
+   }
+
+   for(i = 0; i < nthreads; i++)
+   {
+      resetArena(&job.workers[i].arena, false);
+      freeLock(&job.queues[i].lock);
+      gFree(NULL, job.queues[i].files);
+   }
+
+   // Merge in input order.
+   for(i = 0; i < count; i++)
+   {
+      fileResult *fr = &job.results[i];
+
+      if(fr->result.result > ret)
+         ret = fr->result.result;
+
+      if(diagnostics)
+      {
+         fr->result.firstdiag = diagnostics->count;
+
+         for(j = 0; j < fr->diagnostics.count; j++)
+         {
+            const gDiagnostic *d = &fr->diagnostics.list[j];
+            gAddDiagnostic(diagnostics, d->code, d->severity, paths[i], d->linenum, d->charnum, 
+                           d->sarg[0], d->sarg[1], d->iarg[0], d->iarg[1]);
+         }
+
+         fr->result.ndiags = fr->diagnostics.count;
+      }
+
+      if(results)
+         results[i] = fr->result;
+
+      gFreeDiagnostics(&fr->diagnostics);
+   }
+
+   gFree(NULL, job.results);
+   gFree(NULL, job.queues);
+   gFree(NULL, job.workers);
+
+   return ret;
+}
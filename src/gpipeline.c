@@ -0,0 +1,455 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include "gpipeline.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The queue indices are read with acquire and written with release 
+// semantics, which is all the synchronization the queue needs. MSVC gives
+// volatile accesses these semantics.
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#define PIPE_LOAD(var)        (var)
+#define PIPE_STORE(var, val)  ((var) = (val))
+#define PIPE_YIELD()          SwitchToThread()
+#else
+#include <pthread.h>
+#include <sched.h>
+#define PIPE_LOAD(var)        __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define PIPE_STORE(var, val)  __atomic_store_n(&(var), (val), __ATOMIC_RELEASE)
+#define PIPE_YIELD()          sched_yield()
+#endif
+
+// Spins this many times on an empty or full queue before giving up the CPU.
+#define PIPE_SPINS 64
+
+
+// ----------------------------------------------------------------------------
+// Token queue
+// A ring of entries written by the lexer thread and read by the consumer. 
+// head is only written by the lexer, tail only by the consumer. Each entry
+// keeps its string and diagnostic buffers between uses.
+
+typedef struct
+{
+   gToken         token;
+   char           *string;
+   unsigned int   size;
+
+   long           position;   // Source position before the token
+   int            linenum;    // Stream line/char after the token
+   int            charnum;
+   bool           end;        // Set on the last token of the stream
+
+   gDiagnostic    *diags;     // Diagnostics reported while lexing the token
+   int            ndiags;
+   int            maxdiags;
+} pipeEntry;
+
+typedef struct
+{
+   gTokenStream   *lexer;     // Private stream run by the lexer thread
+   gTokenParms    parms;      // Copy of the parameters without setError
+
+   pipeEntry      *entries;
+   unsigned int   mask;
+
+   volatile unsigned int head;   // Next entry the lexer writes
+   volatile unsigned int tail;   // Next entry the consumer releases
+   volatile int   stop;          // Asks the lexer thread to quit
+
+   // Source position after the last token, written by the lexer before it
+   // publishes the end entry. The thread is gone once that entry is out.
+   long           endposition;
+
+   bool           holding;    // Consumer still uses the entry at tail
+   bool           running;
+   bool           synchronous; // The thread couldn't be started, the consumer lexes
+
+#ifdef _WIN32
+   HANDLE         thread;
+#else
+   pthread_t      thread;
+#endif
+} tokPipe;
+
+
+
+// runLexer
+// Body of the lexer thread. Runs the original source into the queue until
+// the end of the stream or until asked to stop.
+static void runLexer(tokPipe *pipe)
+{
+   gTokenStream   *lexer = pipe->lexer;
+   pipeEntry      *e;
+   gToken         t;
+   unsigned int   head = pipe->head, len;
+   int            spins, first, i;
+
+   while(!PIPE_LOAD(pipe->stop))
+   {
+      // Wait for a free entry.
+      for(spins = 0; head - PIPE_LOAD(pipe->tail) > pipe->mask; spins++)
+      {
+         if(PIPE_LOAD(pipe->stop))
+            return;
+         if(spins >= PIPE_SPINS)
+            PIPE_YIELD();
+      }
+
+      e = &pipe->entries[head & pipe->mask];
+
+      e->position = lexer->source.tellsource ? lexer->source.tellsource(lexer) : 0;
+      first = lexer->diagnostics.count;
+
+      lexer->source.nexttoken(lexer, &t);
+
+      e->token = t;
+      if(t.token)
+      {
+         len = strlen(t.token) + 1;
+         if(len > e->size)
+         {
+            e->size = len < 16 ? 16 : len;
+            e->string = gRealloc(lexer->allocator, e->string, e->size);
+         }
+         e->token.token = memcpy(e->string, t.token, len);
+      }
+
+      e->linenum = lexer->linenum;
+      e->charnum = lexer->charnum;
+      e->end = lexer->endofstream;
+
+      // The records are copied; their strings live in the lexer's buffer,
+      // which is only cleared while the thread is stopped.
+      e->ndiags = lexer->diagnostics.count - first;
+      if(e->ndiags > e->maxdiags)
+      {
+         e->maxdiags = e->ndiags;
+         e->diags = gRealloc(lexer->allocator, e->diags, sizeof(gDiagnostic) * e->maxdiags);
+      }
+      for(i = 0; i < e->ndiags; i++)
+         e->diags[i] = lexer->diagnostics.list[first + i];
+
+      if(e->end)
+         pipe->endposition = lexer->source.tellsource ? lexer->source.tellsource(lexer) : 0;
+
+      // Publish
+      PIPE_STORE(pipe->head, ++head);
+
+      if(e->end)
+         return;
+   }
+}
+
+
+#ifdef _WIN32
+static unsigned __stdcall lexerThread(void *data)
+{
+   runLexer((tokPipe *)data);
+   return 0;
+}
+#else
+static void *lexerThread(void *data)
+{
+   runLexer((tokPipe *)data);
+   return NULL;
+}
+#endif
+
+
+
+// startLexer
+// Starts the lexer thread at the consumer's position in the stream. Returns
+// false if the thread couldn't be created.
+static bool startLexer(gTokenStream *tokstrm, tokPipe *pipe)
+{
+   pipe->lexer->linenum = tokstrm->linenum;
+   pipe->lexer->charnum = tokstrm->charnum;
+   pipe->lexer->endofstream = false;
+
+   pipe->head = pipe->tail = 0;
+   pipe->holding = false;
+   pipe->stop = 0;
+
+#ifdef _WIN32
+   pipe->thread = (HANDLE)_beginthreadex(NULL, 0, lexerThread, pipe, 0, NULL);
+   if(!pipe->thread)
+      return false;
+#else
+   if(pthread_create(&pipe->thread, NULL, lexerThread, pipe) != 0)
+      return false;
+#endif
+
+   pipe->running = true;
+   return true;
+}
+
+
+
+// stopLexer
+// Stops the lexer thread and throws away whatever it read ahead.
+static void stopLexer(tokPipe *pipe)
+{
+   if(!pipe->running)
+      return;
+
+   PIPE_STORE(pipe->stop, 1);
+
+#ifdef _WIN32
+   WaitForSingleObject(pipe->thread, INFINITE);
+   CloseHandle(pipe->thread);
+#else
+   pthread_join(pipe->thread, NULL);
+#endif
+
+   pipe->running = false;
+   pipe->head = pipe->tail = 0;
+   pipe->holding = false;
+}
+
+
+
+// nextEntry
+// Returns the entry after the one being held, waiting for the lexer if it
+// hasn't been written yet. Returns NULL if the lexer thread can't be 
+// started; the pipe is synchronous from then on.
+static pipeEntry *nextEntry(gTokenStream *tokstrm, tokPipe *pipe)
+{
+   unsigned int index;
+   int          spins;
+
+   if(!pipe->running && !startLexer(tokstrm, pipe))
+   {
+      pipe->synchronous = true;
+      return NULL;
+   }
+
+   index = pipe->tail + (pipe->holding ? 1 : 0);
+
+   for(spins = 0; PIPE_LOAD(pipe->head) == index; spins++)
+   {
+      if(spins >= PIPE_SPINS)
+         PIPE_YIELD();
+   }
+
+   return &pipe->entries[index & pipe->mask];
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Token source
+
+// nextSyncToken
+// Runs the original source on the consumer thread, for when the lexer 
+// thread couldn't be started. The lexer stream follows the position of the
+// consumer and its diagnostics are passed on.
+static void nextSyncToken(gTokenStream *tokstrm, tokPipe *pipe, gToken *out)
+{
+   gTokenStream   *lexer = pipe->lexer;
+   int            i, first = lexer->diagnostics.count;
+
+   lexer->linenum = tokstrm->linenum;
+   lexer->charnum = tokstrm->charnum;
+   lexer->endofstream = tokstrm->endofstream;
+
+   lexer->source.nexttoken(lexer, out);
+
+   for(i = first; i < lexer->diagnostics.count; i++)
+   {
+      const gDiagnostic *d = &lexer->diagnostics.list[i];
+      gReportDiagnostic(tokstrm, d->code, d->severity, d->linenum, d->charnum, 
+                        d->sarg[0], d->sarg[1], d->iarg[0], d->iarg[1]);
+   }
+
+   tokstrm->linenum = lexer->linenum;
+   tokstrm->charnum = lexer->charnum;
+   tokstrm->endofstream = lexer->endofstream;
+}
+
+
+
+static void nextPipeToken(gTokenStream *tokstrm, gToken *out)
+{
+   tokPipe     *pipe = (tokPipe *)tokstrm->source.data;
+   pipeEntry   *e;
+   int         i;
+
+   // The last token is handed out again if asked for.
+   if(pipe->holding && pipe->entries[pipe->tail & pipe->mask].end)
+   {
+      *out = pipe->entries[pipe->tail & pipe->mask].token;
+      tokstrm->endofstream = true;
+      return;
+   }
+
+   if(pipe->synchronous || !(e = nextEntry(tokstrm, pipe)))
+   {
+      nextSyncToken(tokstrm, pipe, out);
+      return;
+   }
+
+   // The token given out last time has been copied by now.
+   if(pipe->holding)
+      PIPE_STORE(pipe->tail, pipe->tail + 1);
+   pipe->holding = true;
+
+   for(i = 0; i < e->ndiags; i++)
+   {
+      const gDiagnostic *d = &e->diags[i];
+      gReportDiagnostic(tokstrm, d->code, d->severity, d->linenum, d->charnum, 
+                        d->sarg[0], d->sarg[1], d->iarg[0], d->iarg[1]);
+   }
+
+   *out = e->token;
+   tokstrm->linenum = e->linenum;
+   tokstrm->charnum = e->charnum;
+
+   if(e->end)
+      tokstrm->endofstream = true;
+}
+
+
+
+// tellPipe
+// The position is the one before the next entry. Once the end entry has been
+// handed out there is no next entry and the lexer thread has quit, so the 
+// position saved after the last token is returned instead of waiting.
+static long tellPipe(gTokenStream *tokstrm)
+{
+   tokPipe     *pipe = (tokPipe *)tokstrm->source.data;
+   pipeEntry   *e;
+
+   if(pipe->holding && pipe->entries[pipe->tail & pipe->mask].end)
+      return pipe->endposition;
+
+   if(pipe->synchronous || !(e = nextEntry(tokstrm, pipe)))
+      return pipe->lexer->source.tellsource(pipe->lexer);
+
+   return e->position;
+}
+
+
+
+// seekPipe
+// Seeking throws the read-ahead away. The lexer thread is restarted at the
+// new position by the next request, after the caller has set the line and
+// char.
+static void seekPipe(gTokenStream *tokstrm, long position)
+{
+   tokPipe *pipe = (tokPipe *)tokstrm->source.data;
+
+   stopLexer(pipe);
+   pipe->lexer->source.seeksource(pipe->lexer, position);
+}
+
+
+
+static void resetPipe(gTokenStream *tokstrm)
+{
+   tokPipe *pipe = (tokPipe *)tokstrm->source.data;
+
+   stopLexer(pipe);
+   gResetTokenStream(pipe->lexer);
+}
+
+
+
+static void freePipe(gTokenStream *tokstrm)
+{
+   tokPipe           *pipe = (tokPipe *)tokstrm->source.data;
+   const gAllocator  *allocator = tokstrm->allocator;
+   unsigned int      i;
+
+   stopLexer(pipe);
+
+   for(i = 0; i <= pipe->mask; i++)
+   {
+      if(pipe->entries[i].string)
+         gFree(allocator, pipe->entries[i].string);
+      if(pipe->entries[i].diags)
+         gFree(allocator, pipe->entries[i].diags);
+   }
+
+   gFree(allocator, pipe->entries);
+
+   // The lexer stream frees the original source.
+   gFreeTokenStream(pipe->lexer);
+   gFree(allocator, pipe);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// gStartTokenPipeline
+
+bool gStartTokenPipeline(gTokenStream *tokstrm, int queuesize)
+{
+   tokPipe        *pipe;
+   unsigned int   size = 2;
+
+   if(!tokstrm || tokstrm->source.nexttoken == nextPipeToken)
+      return false;
+
+   if(queuesize <= 0)
+      queuesize = GPIPELINE_DEFAULTSIZE;
+
+   while(size < (unsigned int)queuesize)
+      size <<= 1;
+
+   pipe = (tokPipe *)gAlloc(tokstrm->allocator, sizeof(tokPipe));
+   memset(pipe, 0, sizeof(*pipe));
+
+   pipe->entries = (pipeEntry *)gAlloc(tokstrm->allocator, sizeof(pipeEntry) * size);
+   memset(pipe->entries, 0, sizeof(pipeEntry) * size);
+   pipe->mask = size - 1;
+
+   // The lexer thread gets its own stream over the same text stream and 
+   // compiled parms, running the original source. Its diagnostics are 
+   // reported again by the consumer, so it must not call setError itself.
+   pipe->lexer = gCreateCompiledTokenStreamEx(tokstrm->compiled, tokstrm->stream, tokstrm->name, tokstrm->allocator);
+   pipe->lexer->source = tokstrm->source;
+   pipe->parms = *tokstrm->parameters;
+   pipe->parms.setError = NULL;
+   pipe->lexer->parameters = &pipe->parms;
+
+   tokstrm->source.nexttoken = nextPipeToken;
+   tokstrm->source.resetsource = resetPipe;
+   tokstrm->source.freesource = freePipe;
+   tokstrm->source.tellsource = pipe->lexer->source.seeksource ? tellPipe : NULL;
+   tokstrm->source.seeksource = pipe->lexer->source.seeksource ? seekPipe : NULL;
+   tokstrm->source.data = pipe;
+
+   return true;
+}
@@ -36,6 +36,9 @@
 // ----------------------------------------------------------------------------
 // gStack
 // Generalized stack container object.
+//
+// Entries live in one growable array. Pointer stacks store one object 
+// pointer per entry; inline stacks store entrysize bytes per entry in place.
 
 void stackFreeNOP(void *obj) {}
 
@@ -45,13 +48,44 @@ void stackFreeNOP(void *obj) {}
 // freeFunc is NULL, a NOP is used. 
 gStack *gNewStack(void (*freeFunc)(void *))
 {
-   gStack *ret = malloc(sizeof(gStack));
+   return gNewStackEx(freeFunc, NULL);
+}
+
+
+// gNewStackEx
+// Same as gNewStack, allocating everything with the given allocator.
+gStack *gNewStackEx(void (*freeFunc)(void *), const gAllocator *allocator)
+{
+   gStack *ret = gAlloc(allocator, sizeof(gStack));
    gInitStack(ret, freeFunc);
+   if(allocator)
+      ret->allocator = allocator;
    ret->freestruct = true;
    return ret;
 }
 
 
+// gNewInlineStack
+// Allocates a stack which stores entries of entrysize bytes in place.
+gStack *gNewInlineStack(unsigned int entrysize, void (*freeFunc)(void *))
+{
+   return gNewInlineStackEx(entrysize, freeFunc, NULL);
+}
+
+
+// gNewInlineStackEx
+// Same as gNewInlineStack, allocating everything with the given allocator.
+gStack *gNewInlineStackEx(unsigned int entrysize, void (*freeFunc)(void *), const gAllocator *allocator)
+{
+   gStack *ret = gNewStackEx(freeFunc, allocator);
+
+   ret->entrysize = entrysize;
+   ret->inlineEntries = true;
+
+   return ret;
+}
+
+
 // gInitStack
 // Initializes the given list structure. This is called by gNewStack on the 
 // allocated stack structure.
@@ -59,6 +93,25 @@ void gInitStack(gStack *stack, void (*freeFunc)(void *))
 {
    memset(stack, 0, sizeof(*stack));
    stack->freeFunc = freeFunc ? freeFunc : stackFreeNOP;
+   stack->allocator = gGetAllocator();
+   stack->entrysize = sizeof(void *);
+}
+
+
+// entryAt
+// Returns the storage of entry i.
+static char *entryAt(gStack *s, unsigned int i)
+{
+   return s->entries + (size_t)i * s->entrysize;
+}
+
+
+// entryObject
+// Returns what the stack hands out for entry i: the object of a pointer
+// stack, or the entry itself for an inline stack.
+static void *entryObject(gStack *s, unsigned int i)
+{
+   return s->inlineEntries ? (void *)entryAt(s, i) : *(void **)entryAt(s, i);
 }
 
 
@@ -67,24 +120,13 @@ void gInitStack(gStack *stack, void (*freeFunc)(void *))
 // freestructflag is set in the given list struct, the struct itself is freed.
 void gFreeStack(gStack *s)
 {
-   gStackEntry *it, *pr;
-
-   for(it = s->top; it; it = pr)
-   {
-      pr = it->prev;
-
-      s->freeFunc(it->entry);
-      free(it);
-   }
+   gClearStack(s);
 
-   for(it = s->unused; it; it = pr)
-   {
-      pr = it->prev;
-      free(it);
-   }
+   if(s->entries)
+      gFree(s->allocator, s->entries);
 
    if(s->freestruct)
-      free(s);
+      gFree(s->allocator, s);
    else
       memset(s, 0, sizeof(*s));
 }
@@ -92,46 +134,61 @@ void gFreeStack(gStack *s)
 
 
 // gClearStack
-// Frees all objects contained in a gStack, but keeps the list
-// structures allocated.
+// Frees all objects contained in a gStack, but keeps the entry array
+// allocated.
 void gClearStack(gStack *s)
 {
-   gStackEntry *it, *pr;
+   while(s->size)
+      s->freeFunc(entryObject(s, --s->size));
+}
 
-   for(it = s->top; it; it = pr)
-   {
-      pr = it->prev;
 
-      s->freeFunc(it->entry);
+// gReserveStack
+// Makes room for count entries.
+void gReserveStack(gStack *s, unsigned int count)
+{
+   if(count <= s->max)
+      return;
+
+   s->entries = gRealloc(s->allocator, s->entries, (size_t)count * s->entrysize);
+   s->max = count;
+}
 
-      it->prev = s->unused;
-      s->unused = it;
-   }
 
-   s->top = NULL;
+// pushSlot
+// Adds an entry and returns its storage.
+static char *pushSlot(gStack *s)
+{
+   if(s->size == s->max)
+      gReserveStack(s, s->max ? s->max * 2 : GSTACK_MINSIZE);
+
+   return entryAt(s, s->size++);
 }
 
 
 // gPushEntry
-// Adds the given object to the end of the given stack.
+// Adds the given object to the end of the given stack. Inline stacks copy
+// the entry the object points to.
 void gPushEntry(gStack *s, void *object)
 {
-   gStackEntry *it;
-
    if(!object)
       return;
 
-   if(s->unused)
-   {
-      it = s->unused;
-      s->unused = it->prev;
-   }
+   if(s->inlineEntries)
+      memcpy(pushSlot(s), object, s->entrysize);
    else
-      it = malloc(sizeof(gStackEntry));
+      *(void **)pushSlot(s) = object;
+}
+
+
+// gPushInlineEntry
+// Adds an entry to an inline stack and returns it for the caller to fill.
+void *gPushInlineEntry(gStack *s)
+{
+   if(!s->inlineEntries)
+      return NULL;
 
-   it->entry = object;
-   it->prev = s->top;
-   s->top = it;
+   return pushSlot(s);
 }
 
 
@@ -139,21 +196,15 @@ void gPushEntry(gStack *s, void *object)
 // Returns the current top item on the stack
 void *gGetStackTop(gStack *s)
 {
-   return s->top ? s->top->entry : NULL;
+   return s->size ? entryObject(s, s->size - 1) : NULL;
 }
 
 
 // gGetStackSize
-// Polls the stack and returns the number of entries in the stack.
+// Returns the number of entries in the stack.
 int gGetStackSize(gStack *s)
 {
-   gStackEntry *it;
-   int count = 0;
-
-   for(it = s->top; it; it = it->prev)
-      count++;
-
-   return count;
+   return (int)s->size;
 }
 
 
@@ -162,18 +213,10 @@ int gGetStackSize(gStack *s)
 // the stack is empty).
 void *gPopStack(gStack *s)
 {
-   gStackEntry *it, *ret;
-
-   if(!(it = s->top))
+   if(!s->size)
       return NULL;
 
-   ret = s->top = it->prev;
-
-   s->freeFunc(it->entry);
-   it->prev = s->unused;
-   s->unused = it;
+   s->freeFunc(entryObject(s, --s->size));
 
-   return ret->entry;
+   return gGetStackTop(s);
 }
-
-
@@ -76,8 +76,10 @@ typedef struct
 
 static gTextStream *newStream()
 {
-   gTextStream *ret = (gTextStream *)malloc(sizeof(gTextStream));
+   const gAllocator *allocator = gGetAllocator();
+   gTextStream *ret = (gTextStream *)gAlloc(allocator, sizeof(gTextStream));
    memset(ret, 0, sizeof(*ret));
+   ret->allocator = allocator;
    return ret;
 }
 
@@ -272,8 +274,8 @@ static char *readAheadFile(gTextStream *stream, unsigned int count)
       // read-ahead has exceeded buffer length, so increase buffer size.
       int newsize = count + 1;
 
-      fs->fbuffer = (char *)realloc(fs->fbuffer, newsize);
-      fs->tempstr = (char *)realloc(fs->tempstr, newsize);
+      fs->fbuffer = (char *)gRealloc(stream->allocator, fs->fbuffer, newsize);
+      fs->tempstr = (char *)gRealloc(stream->allocator, fs->tempstr, newsize);
       memset(fs->fbuffer + fs->buffermax, 0, newsize - fs->buffermax); 
       fs->buffermax = newsize;
    }
@@ -309,6 +311,20 @@ static char *readAheadFile(gTextStream *stream, unsigned int count)
 
 
 
+// Number of chars a file stream hands out per gReadSpan call.
+#define FILE_SPANSIZE 256
+
+// Returns a chunk of the read-ahead buffer. File streams can't hand out their
+// raw buffer, so this goes through readAheadFile.
+static const char *readSpanFile(gTextStream *stream, unsigned int *length)
+{
+   const char *ret = readAheadFile(stream, FILE_SPANSIZE);
+
+   *length = ret ? strlen(ret) : 0;
+   return ret;
+}
+
+
 
 static void seekFile(gTextStream *stream, int offset)
 {
@@ -402,16 +418,16 @@ static void freeStreamFile(gTextStream *stream)
    fileStream  *fs = (fileStream *)stream->data;
 
    if(fs->fbuffer)
-      free(fs->fbuffer);
+      gFree(stream->allocator, fs->fbuffer);
 
    if(fs->tempstr)
-      free(fs->tempstr);
+      gFree(stream->allocator, fs->tempstr);
 
    fclose(fs->f);
 
-   free(fs);
+   gFree(stream->allocator, fs);
 
-   free(stream);
+   gFree(stream->allocator, stream);
 }
 
 
@@ -427,7 +443,7 @@ gTextStream *gStreamFromFile(FILE *file)
 
    ret = newStream();
 
-   ret->data = (fs = malloc(sizeof(fileStream)));
+   ret->data = (fs = gAlloc(ret->allocator, sizeof(fileStream)));
    memset(fs, 0, sizeof(*fs));
 
    fs->f = file;
@@ -437,8 +453,8 @@ gTextStream *gStreamFromFile(FILE *file)
    fseek(file, 0, SEEK_SET);
 
    fs->buffermax = 10;
-   fs->fbuffer = malloc(sizeof(char) * fs->buffermax);
-   fs->tempstr = malloc(sizeof(char) * fs->buffermax);
+   fs->fbuffer = gAlloc(ret->allocator, sizeof(char) * fs->buffermax);
+   fs->tempstr = gAlloc(ret->allocator, sizeof(char) * fs->buffermax);
    fs->tempstr[0] = 0;
 
    if(ret->streamlen < 9)
@@ -455,6 +471,7 @@ gTextStream *gStreamFromFile(FILE *file)
    ret->readchar = readCharFile;
    ret->seek = seekFile;
    ret->readahead = readAheadFile;
+   ret->readspan = readSpanFile;
    ret->freestream = freeStreamFile;
 
    return ret;
@@ -522,7 +539,7 @@ static char *readAheadMemory(gTextStream *stream, unsigned int count)
    if(sd->buffermax <= (int)count)
    {
       int newsize = count + 1;
-      sd->tempstr = (char *)realloc(sd->tempstr, newsize);
+      sd->tempstr = (char *)gRealloc(stream->allocator, sd->tempstr, newsize);
       memset(sd->tempstr, 0, newsize);
       sd->buffermax = newsize;
    }
@@ -543,6 +560,23 @@ static char *readAheadMemory(gTextStream *stream, unsigned int count)
 }
 
 
+// Memory streams can hand out the rest of the buffer directly.
+static const char *readSpanMemory(gTextStream *stream, unsigned int *length)
+{
+   memStream   *sd = (memStream *)stream->data;
+   int         pos = sd->rover - sd->memory;
+
+   if(stream->eofflag || pos >= stream->streamlen)
+   {
+      *length = 0;
+      return NULL;
+   }
+
+   *length = stream->streamlen - pos;
+   return sd->rover;
+}
+
+
 static void seekMemory(gTextStream *stream, int offset)
 {
    memStream   *sd = (memStream *)stream->data;
@@ -574,13 +608,13 @@ static void freeStreamMemory(gTextStream *stream)
    memStream   *sd = (memStream *)stream->data;
 
    if(sd->owner)
-      free(sd->memory);
+      gFree(stream->allocator, sd->memory);
 
    if(sd->tempstr)
-      free(sd->tempstr);
+      gFree(stream->allocator, sd->tempstr);
      
-   free(sd);
-   free(stream);
+   gFree(stream->allocator, sd);
+   gFree(stream->allocator, stream);
 }
 
 
@@ -596,7 +630,7 @@ gTextStream *gStreamFromMemory(char *memory, int length, bool owner)
 
    ret = newStream();
 
-   ret->data = (sd = malloc(sizeof(memStream)));
+   ret->data = (sd = gAlloc(ret->allocator, sizeof(memStream)));
    memset(sd, 0, sizeof(sd));
 
    ret->streamlen = length;
@@ -606,13 +640,14 @@ gTextStream *gStreamFromMemory(char *memory, int length, bool owner)
    sd->owner = owner;
 
    sd->buffermax = 10;
-   sd->tempstr = malloc(sizeof(char) * sd->buffermax);
+   sd->tempstr = gAlloc(ret->allocator, sizeof(char) * sd->buffermax);
    sd->tempstr[0] = 0;
 
    ret->ggetchar = getCharMemory;
    ret->readchar = readCharMemory;
    ret->seek = seekMemory;
    ret->readahead = readAheadMemory;
+   ret->readspan = readSpanMemory;
    ret->freestream = freeStreamMemory;
 
    return ret;
@@ -631,21 +666,29 @@ void gSeekPos(gTextStream *txtstrm, int pos)
 
    if(pos < 0)
       pos = 0;
-   if(pos >= txtstrm->streamlen)
-      pos = txtstrm->streamlen - 1;
+   if(pos > txtstrm->streamlen)
+      pos = txtstrm->streamlen;
 
-   if(txtstrm->seek = seekMemory)
+   offset = pos - gTellPos(txtstrm);
+
+   gSeek(txtstrm, offset);
+}
+
+
+// gTellPos
+// Returns the absolute position within the stream
+int gTellPos(gTextStream *txtstrm)
+{
+   if(txtstrm->seek == seekMemory)
    {
       memStream *sd = (memStream *)txtstrm->data;
-      offset = pos - (sd->rover - sd->memory);
+      return sd->rover - sd->memory;
    }
    else
    {
       fileStream *fs = (fileStream *)txtstrm->data;
-      offset = pos - fs->fbufferpos;
+      return fs->fbufferpos;
    }
-
-   gSeek(txtstrm, offset);
 }
 
 
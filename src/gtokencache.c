@@ -0,0 +1,675 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+#include "gtokencache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#define getpid _getpid
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+#define BYTEORDER_MARK 0x01020304
+
+// ----------------------------------------------------------------------------
+// Hashing
+// 64 bit FNV-1a, used both for the source text and the parms fingerprint.
+
+// Built from 32 bit halves, VC6 has no 64 bit literal suffix.
+#define FNV_OFFSET   (((gHash64)0xcbf29ce4 << 32) | 0x84222325)
+#define FNV_PRIME    (((gHash64)0x00000100 << 32) | 0x000001b3)
+
+static gHash64 hashBytes(gHash64 hash, const void *data, unsigned int length)
+{
+   const unsigned char *p = (const unsigned char *)data, *end = p + length;
+
+   while(p < end)
+   {
+      hash ^= *p++;
+      hash *= FNV_PRIME;
+   }
+
+   return hash;
+}
+
+
+
+static gHash64 hashInt(gHash64 hash, int value)
+{
+   return hashBytes(hash, &value, sizeof(value));
+}
+
+
+
+// Strings are hashed with their terminator so "ab","c" differs from "a","bc".
+// NULL hashes differently from "".
+static gHash64 hashString(gHash64 hash, const char *str)
+{
+   if(!str)
+      return hashInt(hash, -1);
+
+   return hashBytes(hash, str, strlen(str) + 1);
+}
+
+
+
+gHash64 gParmsFingerprint(const gTokenParms *parms)
+{
+   gHash64 hash = FNV_OFFSET;
+   int     i;
+
+   hash = hashInt(hash, GTOKCACHE_VERSION);
+   hash = hashInt(hash, parms->flags);
+
+   for(i = 0; parms->keywlist && parms->keywlist[i].token; i++)
+   {
+      hash = hashString(hash, parms->keywlist[i].token);
+      hash = hashInt(hash, parms->keywlist[i].newtype);
+      hash = hashString(hash, parms->keywlist[i].newtoken);
+   }
+   hash = hashInt(hash, i);
+
+   for(i = 0; parms->symbollist && parms->symbollist[i].token[0]; i++)
+   {
+      hash = hashString(hash, parms->symbollist[i].token);
+      hash = hashInt(hash, parms->symbollist[i].newtype);
+   }
+   hash = hashInt(hash, i);
+
+   for(i = 0; parms->escapelist && parms->escapelist[i].escchar; i++)
+   {
+      hash = hashInt(hash, parms->escapelist[i].escchar);
+      hash = hashInt(hash, parms->escapelist[i].replacechar);
+   }
+   hash = hashInt(hash, i);
+
+   hash = hashString(hash, parms->comment1s);
+   hash = hashString(hash, parms->comment1e);
+   hash = hashString(hash, parms->comment2s);
+   hash = hashString(hash, parms->comment2e);
+
+   for(i = 0; parms->commentlist && parms->commentlist[i].start; i++)
+   {
+      hash = hashString(hash, parms->commentlist[i].start);
+      hash = hashString(hash, parms->commentlist[i].end);
+      hash = hashInt(hash, parms->commentlist[i].nestable ? 1 : 0);
+   }
+   hash = hashInt(hash, i);
+
+   return hash;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// File helpers
+
+// readFile
+// Reads a whole file into a buffer allocated with the global allocator.
+static char *readFile(const char *path, unsigned int *length)
+{
+   FILE  *f = fopen(path, "rb");
+   char  *buffer;
+   long  size;
+
+   if(!f)
+      return NULL;
+
+   fseek(f, 0, SEEK_END);
+   size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+
+   if(size < 0 || !(buffer = (char *)gAlloc(NULL, size + 1)))
+   {
+      fclose(f);
+      return NULL;
+   }
+
+   if(size && fread(buffer, size, 1, f) != 1)
+   {
+      gFree(NULL, buffer);
+      fclose(f);
+      return NULL;
+   }
+
+   fclose(f);
+
+   buffer[size] = 0;
+   *length = (unsigned int)size;
+   return buffer;
+}
+
+
+
+// mapFile
+// Maps a whole file read-only. handle receives whatever unmapFile needs.
+static const char *mapFile(const char *path, unsigned int *length, void **handle)
+{
+#ifdef _WIN32
+   HANDLE file, mapping;
+   DWORD  size;
+   const char *view;
+
+   file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if(file == INVALID_HANDLE_VALUE)
+      return NULL;
+
+   size = GetFileSize(file, NULL);
+   if(size == INVALID_FILE_SIZE || size == 0)
+   {
+      CloseHandle(file);
+      return NULL;
+   }
+
+   mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   CloseHandle(file);
+   if(!mapping)
+      return NULL;
+
+   view = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+   if(!view)
+   {
+      CloseHandle(mapping);
+      return NULL;
+   }
+
+   *length = size;
+   *handle = mapping;
+   return view;
+#else
+   struct stat st;
+   void   *view;
+   int    fd = open(path, O_RDONLY);
+
+   if(fd == -1)
+      return NULL;
+
+   if(fstat(fd, &st) == -1 || st.st_size == 0)
+   {
+      close(fd);
+      return NULL;
+   }
+
+   view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if(view == MAP_FAILED)
+      return NULL;
+
+   *length = (unsigned int)st.st_size;
+   *handle = NULL;
+   return (const char *)view;
+#endif
+}
+
+
+
+static void unmapFile(const char *view, unsigned int length, void *handle)
+{
+#ifdef _WIN32
+   UnmapViewOfFile(view);
+   CloseHandle((HANDLE)handle);
+#else
+   munmap((void *)view, length);
+#endif
+}
+
+
+
+// writeFile
+// Writes the image to a temporary file and renames it over the cache, so 
+// a reader never sees a half written cache. The temporary name includes the
+// process id so processes refreshing the same cache don't write into each
+// other's file.
+static void writeFile(const char *path, const char *image, unsigned int length)
+{
+   char  *temppath;
+   FILE  *f;
+   bool  ok;
+
+   temppath = (char *)gAlloc(NULL, strlen(path) + 32);
+   sprintf(temppath, "%s.%lu.tmp", path, (unsigned long)getpid());
+
+   if(!(f = fopen(temppath, "wb")))
+   {
+      gFree(NULL, temppath);
+      return;
+   }
+
+   ok = fwrite(image, length, 1, f) == 1;
+   ok = fclose(f) == 0 && ok;
+
+#ifdef _WIN32
+   // rename won't replace an existing file on Windows.
+   if(ok)
+      remove(path);
+#endif
+
+   if(!ok || rename(temppath, path))
+      remove(temppath);
+
+   gFree(NULL, temppath);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Cache image
+// A cache image is the exact contents of a cache file. It is either mapped
+// from disk or built in memory by lexing the source.
+
+typedef struct
+{
+   const char              *image;     // Start of the image
+   unsigned int            length;     // Size of the image in bytes
+   void                    *handle;    // Mapping handle, unused for built images
+   bool                    mapped;     // Set if image is mapped, otherwise it's allocated
+
+   const gTokCacheRecord   *records;
+   const gTokCacheDiag     *diags;
+   const char              *strings;
+   unsigned int            count;
+   unsigned int            diagcount;
+   unsigned int            next;       // Next record to hand out
+   unsigned int            nextdiag;   // First diagnostic not reported yet
+} tokCache;
+
+
+
+// checkImage
+// Returns true if the image is a well formed cache for the given hashes.
+static bool checkImage(const char *image, unsigned int length, gHash64 contenthash, gHash64 parmshash)
+{
+   const gTokCacheHeader *header = (const gTokCacheHeader *)image;
+   const gTokCacheRecord *records;
+   const gTokCacheDiag   *diags;
+   const char            *strings;
+   unsigned int          i, j;
+
+   if(length < sizeof(gTokCacheHeader))
+      return false;
+
+   if(memcmp(header->magic, "GTOK", 4) || header->version != GTOKCACHE_VERSION 
+      || header->byteorder != BYTEORDER_MARK)
+      return false;
+
+   if(header->contenthash != contenthash || header->parmshash != parmshash)
+      return false;
+
+   if(header->count == 0 || header->stringsize == 0
+      || header->count > (length - sizeof(gTokCacheHeader)) / sizeof(gTokCacheRecord)
+      || header->diagcount > (length - sizeof(gTokCacheHeader)) / sizeof(gTokCacheDiag)
+      || length != sizeof(gTokCacheHeader) + header->count * sizeof(gTokCacheRecord) 
+                   + header->diagcount * sizeof(gTokCacheDiag) + header->stringsize)
+      return false;
+
+   records = (const gTokCacheRecord *)(image + sizeof(gTokCacheHeader));
+   diags = (const gTokCacheDiag *)(records + header->count);
+   strings = (const char *)(diags + header->diagcount);
+
+   if(strings[header->stringsize - 1] || records[header->count - 1].type != tEOF)
+      return false;
+
+   for(i = 0; i < header->count; i++)
+   {
+      if(records[i].offset >= header->stringsize)
+         return false;
+   }
+
+   for(i = 0; i < header->diagcount; i++)
+   {
+      if(diags[i].token >= header->count || (i && diags[i].token < diags[i - 1].token))
+         return false;
+
+      for(j = 0; j < 2; j++)
+      {
+         if(diags[i].sarg[j] != GTOKCACHE_NOSTRING && diags[i].sarg[j] >= header->stringsize)
+            return false;
+      }
+   }
+
+   return true;
+}
+
+
+
+static void setImage(tokCache *cache, const char *image, unsigned int length)
+{
+   const gTokCacheHeader *header = (const gTokCacheHeader *)image;
+
+   cache->image = image;
+   cache->length = length;
+   cache->records = (const gTokCacheRecord *)(image + sizeof(gTokCacheHeader));
+   cache->diags = (const gTokCacheDiag *)(cache->records + header->count);
+   cache->strings = (const char *)(cache->diags + header->diagcount);
+   cache->count = header->count;
+   cache->diagcount = header->diagcount;
+   cache->next = cache->nextdiag = 0;
+}
+
+
+
+// stringPool
+// Growable pool of NULL-terminated strings used while building an image.
+typedef struct
+{
+   char           *data;
+   unsigned int   size, max;
+} stringPool;
+
+
+// addString
+// Appends str to the pool and returns its offset.
+static unsigned int addString(stringPool *pool, const char *str, const gAllocator *allocator)
+{
+   unsigned int len = strlen(str) + 1, ret = pool->size;
+
+   if(pool->size + len > pool->max)
+   {
+      pool->max = pool->max ? pool->max * 2 : 4096;
+      if(pool->max < pool->size + len)
+         pool->max = pool->size + len;
+      pool->data = (char *)gRealloc(allocator, pool->data, pool->max);
+   }
+
+   memcpy(pool->data + pool->size, str, len);
+   pool->size += len;
+
+   return ret;
+}
+
+
+// buildImage
+// Lexes the whole token stream and returns the cache image of the tokens.
+// The diagnostics reported for each token are stored along with it instead
+// of going to setError; they are reported when the token is handed out.
+static char *buildImage(gTokenStream *tokstrm, gHash64 contenthash, gHash64 parmshash, unsigned int *length)
+{
+   gTokCacheRecord   *records = NULL;
+   gTokCacheDiag     *diags = NULL, *d;
+   const gTokenParms *parms = tokstrm->parameters;
+   gTokenParms       quiet;
+   stringPool        strings;
+   char              *image, *p;
+   unsigned int      count = 0, maxcount = 0, diagcount = 0, maxdiags = 0;
+   int               first, i, j;
+   gTokCacheHeader   header;
+   gToken            t;
+
+   memset(&strings, 0, sizeof(strings));
+
+   quiet = *parms;
+   quiet.setError = NULL;
+   tokstrm->parameters = &quiet;
+
+   do
+   {
+      first = tokstrm->diagnostics.count;
+
+      tokstrm->source.nexttoken(tokstrm, &t);
+
+      if(count == maxcount)
+      {
+         maxcount = maxcount ? maxcount * 2 : 256;
+         records = (gTokCacheRecord *)gRealloc(tokstrm->allocator, records, sizeof(gTokCacheRecord) * maxcount);
+      }
+
+      for(i = first; i < tokstrm->diagnostics.count; i++)
+      {
+         const gDiagnostic *diag = &tokstrm->diagnostics.list[i];
+
+         if(diagcount == maxdiags)
+         {
+            maxdiags = maxdiags ? maxdiags * 2 : 16;
+            diags = (gTokCacheDiag *)gRealloc(tokstrm->allocator, diags, sizeof(gTokCacheDiag) * maxdiags);
+         }
+
+         d = diags + diagcount++;
+         d->token = count;
+         d->code = diag->code;
+         d->severity = diag->severity;
+         d->linenum = diag->linenum;
+         d->charnum = diag->charnum;
+         d->iarg[0] = diag->iarg[0];
+         d->iarg[1] = diag->iarg[1];
+
+         for(j = 0; j < 2; j++)
+            d->sarg[j] = diag->sarg[j] ? addString(&strings, diag->sarg[j], tokstrm->allocator) : GTOKCACHE_NOSTRING;
+      }
+
+      records[count].type = t.type;
+      records[count].linenum = t.linenum;
+      records[count].charnum = t.charnum;
+      records[count].offset = addString(&strings, t.token, tokstrm->allocator);
+      count++;
+   } while(t.type != tEOF);
+
+   tokstrm->parameters = parms;
+
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, "GTOK", 4);
+   header.version = GTOKCACHE_VERSION;
+   header.byteorder = BYTEORDER_MARK;
+   header.count = count;
+   header.contenthash = contenthash;
+   header.parmshash = parmshash;
+   header.stringsize = strings.size;
+   header.diagcount = diagcount;
+
+   *length = sizeof(header) + sizeof(gTokCacheRecord) * count + sizeof(gTokCacheDiag) * diagcount + strings.size;
+   image = p = (char *)gAlloc(tokstrm->allocator, *length);
+
+   memcpy(p, &header, sizeof(header));
+   p += sizeof(header);
+   memcpy(p, records, sizeof(gTokCacheRecord) * count);
+   p += sizeof(gTokCacheRecord) * count;
+   if(diagcount)
+      memcpy(p, diags, sizeof(gTokCacheDiag) * diagcount);
+   p += sizeof(gTokCacheDiag) * diagcount;
+   memcpy(p, strings.data, strings.size);
+
+   gFree(tokstrm->allocator, records);
+   gFree(tokstrm->allocator, diags);
+   gFree(tokstrm->allocator, strings.data);
+
+   return image;
+}
+
+
+
+// ----------------------------------------------------------------------------
+// Token source
+// Hands out the records of the image. The last record is tEOF and is handed 
+// out again on every further call, the same as the lexer does. Diagnostics 
+// are reported with the token they belong to.
+
+static void nextCachedToken(gTokenStream *tokstrm, gToken *out)
+{
+   tokCache *cache = (tokCache *)tokstrm->source.data;
+   const gTokCacheRecord *r = cache->records + cache->next;
+
+   for(; cache->nextdiag < cache->diagcount && cache->diags[cache->nextdiag].token == cache->next; cache->nextdiag++)
+   {
+      const gTokCacheDiag *d = cache->diags + cache->nextdiag;
+
+      gReportDiagnostic(tokstrm, d->code, d->severity, d->linenum, d->charnum, 
+                        d->sarg[0] == GTOKCACHE_NOSTRING ? NULL : cache->strings + d->sarg[0],
+                        d->sarg[1] == GTOKCACHE_NOSTRING ? NULL : cache->strings + d->sarg[1],
+                        d->iarg[0], d->iarg[1]);
+   }
+
+   out->type = r->type;
+   out->token = (char *)cache->strings + r->offset;
+   out->linenum = r->linenum;
+   out->charnum = r->charnum;
+
+   if(r->type == tEOF)
+   {
+      tokstrm->endofstream = true;
+      tokstrm->linenum = r->linenum;
+      tokstrm->charnum = r->charnum;
+   }
+   else
+      cache->next++;
+}
+
+
+
+static void resetCachedSource(gTokenStream *tokstrm)
+{
+   tokCache *cache = (tokCache *)tokstrm->source.data;
+
+   cache->next = cache->nextdiag = 0;
+}
+
+
+
+// The position of a cached stream is the index of the next record.
+static long tellCachedSource(gTokenStream *tokstrm)
+{
+   return ((tokCache *)tokstrm->source.data)->next;
+}
+
+
+
+// seekCachedSource
+// Also moves the diagnostic cursor to the first record of the token at 
+// position.
+static void seekCachedSource(gTokenStream *tokstrm, long position)
+{
+   tokCache       *cache = (tokCache *)tokstrm->source.data;
+   unsigned int   low = 0, high = cache->diagcount, mid;
+
+   cache->next = position;
+
+   while(low < high)
+   {
+      mid = (low + high) / 2;
+      if(cache->diags[mid].token < (unsigned int)position)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+
+   cache->nextdiag = low;
+}
+
+
+
+static void freeCachedSource(gTokenStream *tokstrm)
+{
+   tokCache *cache = (tokCache *)tokstrm->source.data;
+
+   if(cache->mapped)
+      unmapFile(cache->image, cache->length, cache->handle);
+   else
+      gFree(tokstrm->allocator, (void *)cache->image);
+
+   gFree(tokstrm->allocator, cache);
+
+   // The text stream was created here, so it's released here as well.
+   gFreeStream(tokstrm->stream);
+}
+
+
+
+// ----------------------------------------------------------------------------
+// gOpenCachedTokenStream
+
+gTokenStream *gOpenCachedTokenStream(const char *path, gTokenParms *parms)
+{
+   gTokenStream   *ret;
+   gTextStream    *text;
+   tokCache       *cache;
+   char           *source, *cachepath;
+   unsigned int   sourcelen, length;
+   gHash64        contenthash, parmshash;
+   const char     *image;
+   void           *handle = NULL;
+
+   if(!path || !parms)
+      return NULL;
+
+   if(!(source = readFile(path, &sourcelen)))
+      return NULL;
+
+   contenthash = hashBytes(FNV_OFFSET, source, sourcelen);
+   parmshash = gParmsFingerprint(parms);
+
+   text = gStreamFromMemory(source, sourcelen, true);
+   ret = gCreateTokenStream(parms, text, path);
+
+   cache = (tokCache *)gAlloc(ret->allocator, sizeof(tokCache));
+   memset(cache, 0, sizeof(*cache));
+
+   cachepath = (char *)gAlloc(NULL, strlen(path) + strlen(GTOKCACHE_EXT) + 1);
+   sprintf(cachepath, "%s%s", path, GTOKCACHE_EXT);
+
+   image = mapFile(cachepath, &length, &handle);
+   if(image && checkImage(image, length, contenthash, parmshash))
+   {
+      cache->mapped = true;
+      cache->handle = handle;
+   }
+   else
+   {
+      if(image)
+         unmapFile(image, length, handle);
+
+      // Stale or missing, lex the source and rewrite the cache.
+      image = buildImage(ret, contenthash, parmshash, &length);
+      writeFile(cachepath, image, length);
+   }
+
+   gFree(NULL, cachepath);
+
+   setImage(cache, image, length);
+
+   ret->source.nexttoken = nextCachedToken;
+   ret->source.resetsource = resetCachedSource;
+   ret->source.freesource = freeCachedSource;
+   ret->source.tellsource = tellCachedSource;
+   ret->source.seeksource = seekCachedSource;
+   ret->source.data = cache;
+
+   // Start over; building the image ran the lexer to the end.
+   gResetTokenStream(ret);
+
+   return ret;
+}
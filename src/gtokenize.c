@@ -34,6 +34,38 @@
 #include <string.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+
+#ifdef GPARSE_STATS
+#if defined(_MSC_VER) && _MSC_VER >= 1400
+#include <intrin.h>
+#define STAT_TIMER() __rdtsc()
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define STAT_TIMER() __rdtsc()
+#else
+#include <time.h>
+#define STAT_TIMER() ((guint64)clock())
+#endif
+
+#define STAT_ADD(tokstrm, field, n) ((tokstrm)->stats->field += (n))
+
+// Runs a parse routine, counting the call and the cycles spent in it.
+#define STAT_PARSE(tokstrm, parser, call) \
+   { \
+      guint64 start_ = STAT_TIMER(); \
+      call; \
+      (tokstrm)->stats->parsecycles[parser] += STAT_TIMER() - start_; \
+      (tokstrm)->stats->parsecalls[parser]++; \
+   }
+
+// Every readahead done by the tokenizer goes through this so it can be counted.
+#define READAHEAD(tokstrm, count) (STAT_ADD(tokstrm, readaheads, 1), gReadahead((tokstrm)->stream, count))
+#else
+#define STAT_ADD(tokstrm, field, n)
+#define STAT_PARSE(tokstrm, parser, call) call
+#define READAHEAD(tokstrm, count) gReadahead((tokstrm)->stream, count)
+#endif
 
 static char *gComment1s             = "//";
 static char *gComment1e             = "\n";
@@ -58,7 +90,7 @@ const char *getErrorNOP(void)
 
 gTokenParms *gNewParms()
 {
-   gTokenParms *ret = (gTokenParms *)malloc(sizeof(gTokenParms));
+   gTokenParms *ret = (gTokenParms *)gAllocObject(NULL, sizeof(gTokenParms));
 
    memset(ret, 0, sizeof(*ret));
 
@@ -76,7 +108,195 @@ gTokenParms *gNewParms()
 
 void gFreeParms(gTokenParms *parameters)
 {
-   free(parameters);
+   gFreeObject(parameters);
+}
+
+
+
+// Folds the case of a char if the parms ignore case.
+static unsigned char commentKey(const gCompiledParms *cparms, char c)
+{
+   if(cparms->parms.flags & gIgnoreCase)
+      return (unsigned char)tolower((unsigned char)c);
+
+   return (unsigned char)c;
+}
+
+
+// Adds a comment style to the compiled comment table, keeping the table 
+// grouped by first char and sorted longest first within each group.
+static void addComment(gCompiledParms *cparms, const char *start, const char *end, bool nestable)
+{
+   gCompiledComment c;
+   int i;
+
+   if(!start || !end || !*start || !*end)
+      return;
+
+   c.start = start;
+   c.end = end;
+   c.startlen = strlen(start);
+   c.endlen = strlen(end);
+   c.nestable = nestable;
+   c.scannable = true;
+
+   if(cparms->parms.flags & gIgnoreCase)
+   {
+      if(isalpha((unsigned char)end[0]) || (nestable && isalpha((unsigned char)start[0])))
+         c.scannable = false;
+   }
+
+   // Insertion sort, there are never more than a handful of these.
+   for(i = cparms->numcomments; i > 0; i--)
+   {
+      gCompiledComment *prev = &cparms->comments[i - 1];
+      unsigned char pk = commentKey(cparms, prev->start[0]), ck = commentKey(cparms, start[0]);
+
+      if(pk < ck || (pk == ck && prev->startlen >= c.startlen))
+         break;
+
+      cparms->comments[i] = *prev;
+   }
+
+   cparms->comments[i] = c;
+   cparms->numcomments++;
+}
+
+
+// Frees the tables allocated by compileParms.
+static void releaseParms(gCompiledParms *cparms)
+{
+   if(cparms->comments)
+      gFree(cparms->allocator, cparms->comments);
+
+   if(cparms->symbolnext)
+      gFree(cparms->allocator, cparms->symbolnext);
+
+   cparms->comments = NULL;
+   cparms->symbolnext = NULL;
+}
+
+
+// Fills in a compiled parms object from the given parameters. The tables are
+// allocated with allocator.
+static void compileParms(gCompiledParms *cparms, const gTokenParms *parms, const gAllocator *allocator)
+{
+   int i, count;
+
+   memset(cparms, 0, sizeof(*cparms));
+
+   cparms->allocator = allocator;
+   cparms->parms = *parms;
+   cparms->strncmp = (parms->flags & gIgnoreCase) ? _strnicmp : strncmp;
+
+   // Merge all the comment styles into one table.
+   for(count = 0; parms->commentlist && parms->commentlist[count].start; count++);
+
+   cparms->comments = (gCompiledComment *)gAlloc(allocator, sizeof(gCompiledComment) * (count + 2));
+
+   addComment(cparms, parms->comment1s, parms->comment1e, false);
+   addComment(cparms, parms->comment2s, parms->comment2e, false);
+
+   for(i = 0; i < count; i++)
+      addComment(cparms, parms->commentlist[i].start, parms->commentlist[i].end, parms->commentlist[i].nestable);
+
+   for(i = 0; i < 256; i++)
+   {
+      cparms->commentfirst[i] = -1;
+      cparms->commentcount[i] = 0;
+   }
+
+   for(i = 0; i < cparms->numcomments; i++)
+   {
+      unsigned char key = commentKey(cparms, cparms->comments[i].start[0]);
+
+      if(cparms->commentfirst[key] == -1)
+         cparms->commentfirst[key] = i;
+      cparms->commentcount[key]++;
+   }
+
+   // Upper case chars share the group of their lower case counterpart.
+   for(i = 0; i < 256; i++)
+   {
+      unsigned char key = commentKey(cparms, (char)i);
+
+      cparms->commentfirst[i] = cparms->commentfirst[key];
+      cparms->commentcount[i] = cparms->commentcount[key];
+   }
+
+   // Chain the symbols by first char. The list is walked backwards so each 
+   // chain stays in list order.
+   for(i = 0; i < 256; i++)
+      cparms->symbolfirst[i] = -1;
+
+   for(count = 0; parms->symbollist && parms->symbollist[count].token[0]; count++);
+
+   if(count)
+   {
+      cparms->symbolnext = (int *)gAlloc(allocator, sizeof(int) * count);
+
+      for(i = count - 1; i >= 0; i--)
+      {
+         unsigned char c = (unsigned char)parms->symbollist[i].token[0];
+
+         cparms->symbolnext[i] = cparms->symbolfirst[c];
+         cparms->symbolfirst[c] = i;
+      }
+   }
+
+   // Symbols are at most 3 chars long, comment starts may be longer.
+   cparms->maxlookahead = 3;
+   for(i = 0; i < cparms->numcomments; i++)
+   {
+      if(cparms->comments[i].startlen > cparms->maxlookahead)
+         cparms->maxlookahead = cparms->comments[i].startlen;
+   }
+
+   // Build the escape table. The list is walked backwards so the first entry
+   // for a char wins, like the old linear search did.
+   for(i = 0; i < 256; i++)
+      cparms->escapes[i] = (char)i;
+
+   if(parms->escapelist)
+   {
+      for(i = 0; parms->escapelist[i].escchar; i++);
+
+      while(--i >= 0)
+         cparms->escapes[(unsigned char)parms->escapelist[i].escchar] = parms->escapelist[i].replacechar;
+   }
+}
+
+
+static gCompiledParms *newCompiledParms(const gTokenParms *parms, const gAllocator *allocator)
+{
+   gCompiledParms *ret;
+
+   if(!parms)
+      return NULL;
+
+   if(!allocator)
+      allocator = gGetAllocator();
+
+   ret = (gCompiledParms *)gAlloc(allocator, sizeof(gCompiledParms));
+   compileParms(ret, parms, allocator);
+
+   return ret;
+}
+
+
+gCompiledParms *gCompileParms(const gTokenParms *parms)
+{
+   return newCompiledParms(parms, NULL);
+}
+
+
+void gFreeCompiledParms(gCompiledParms *cparms)
+{
+   if(!cparms)
+      return;
+
+   releaseParms(cparms);
+   gFree(cparms->allocator, cparms);
 }
 
 
@@ -87,10 +307,19 @@ void gFreeParms(gTokenParms *parameters)
 
 gToken *gCreateToken(const char *token, int type, int linenum, int charnum)
 {
-   gToken *ret = (gToken *)malloc(sizeof(gToken));
-   memset(ret, 0, sizeof(*ret));
+   return gCreateTokenEx(token, type, linenum, charnum, NULL);
+}
+
 
-   ret->token = _strdup(token);
+// gCreateTokenEx
+// The token and its string are one allocation, which remembers the allocator
+// so gFreeToken can still be used as a plain free function.
+gToken *gCreateTokenEx(const char *token, int type, int linenum, int charnum, const gAllocator *allocator)
+{
+   size_t len = token ? strlen(token) + 1 : 0;
+   gToken *ret = (gToken *)gAllocObject(allocator, sizeof(gToken) + len);
+
+   ret->token = len ? memcpy(ret + 1, token, len) : NULL;
    ret->type = type;
    ret->linenum = linenum;
    ret->charnum = charnum;
@@ -101,12 +330,7 @@ gToken *gCreateToken(const char *token, int type, int linenum, int charnum)
 
 void gFreeToken(void *object)
 {
-   gToken *token = (gToken *)object;
-
-   if(token->token)
-      free(token->token);
-
-   free(token);
+   gFreeObject(object);
 }
 
 
@@ -117,21 +341,333 @@ void gFreeToken(void *object)
 // This object is the means by which the tokenizer actually does most of the 
 // work.
 
-gTokenStream *gCreateTokenStream(gTokenParms *parameters, gTextStream *stream, const char *name)
+static void lexToken(gTokenStream *tokstrm, gToken *out);
+static void nextToken(gTokenStream *tokstrm, gToken *out);
+
+
+// Token window
+// gGetToken caches tokens in a ring of pages of TOKENPAGE_SIZE tokens each.
+// Token index i lives in page (i / TOKENPAGE_SIZE) & (wpages - 1), so a page
+// holds one aligned block of indices at a time and cached tokens never move.
+// Each slot keeps its string buffer between uses.
+#define TOKENPAGE_SHIFT 6  // log2 of GTOKEN_BLOCKSIZE
+#define TOKENPAGE_SIZE  GTOKEN_BLOCKSIZE
+#define TOKENPAGE_MASK  (TOKENPAGE_SIZE - 1)
+
+typedef struct gTokenPage
+{
+   gToken         tokens[TOKENPAGE_SIZE];
+   char           *strings[TOKENPAGE_SIZE];
+   unsigned int   sizes[TOKENPAGE_SIZE];
+} gTokenPage;
+
+
+static gTokenPage *newTokenPage(const gAllocator *allocator)
+{
+   gTokenPage *ret = (gTokenPage *)gAlloc(allocator, sizeof(gTokenPage));
+
+   memset(ret, 0, sizeof(*ret));
+   return ret;
+}
+
+
+static void freeTokenWindow(gTokenStream *tokstrm)
+{
+   int i, j;
+
+   for(i = 0; i < tokstrm->wpages; i++)
+   {
+      for(j = 0; j < TOKENPAGE_SIZE; j++)
+      {
+         if(tokstrm->window[i]->strings[j])
+            gFree(tokstrm->allocator, tokstrm->window[i]->strings[j]);
+      }
+
+      gFree(tokstrm->allocator, tokstrm->window[i]);
+   }
+
+   gFree(tokstrm->allocator, tokstrm->window);
+
+   if(tokstrm->history)
+   {
+      for(j = 0; j < TOKENPAGE_SIZE; j++)
+      {
+         if(tokstrm->history->strings[j])
+            gFree(tokstrm->allocator, tokstrm->history->strings[j]);
+      }
+
+      gFree(tokstrm->allocator, tokstrm->history);
+   }
+
+   if(tokstrm->checkpoints)
+      gFree(tokstrm->allocator, tokstrm->checkpoints);
+}
+
+
+static gToken *windowToken(const gTokenStream *tokstrm, int index)
+{
+   gTokenPage *page = tokstrm->window[(index >> TOKENPAGE_SHIFT) & (tokstrm->wpages - 1)];
+
+   return &page->tokens[index & TOKENPAGE_MASK];
+}
+
+
+// growWindow
+// Doubles the number of pages. The pages holding cached blocks are moved to
+// their slot in the bigger ring; the tokens inside them stay where they are.
+static void growWindow(gTokenStream *tokstrm)
+{
+   int        oldpages = tokstrm->wpages, newpages = oldpages * 2;
+   int        first = tokstrm->cfirst >> TOKENPAGE_SHIFT;
+   int        last = tokstrm->clast >> TOKENPAGE_SHIFT;
+   gTokenPage **window = gAlloc(tokstrm->allocator, sizeof(gTokenPage *) * newpages);
+   int        i, spare;
+
+   memset(window, 0, sizeof(gTokenPage *) * newpages);
+
+   for(i = first; i <= last; i++)
+   {
+      window[i & (newpages - 1)] = tokstrm->window[i & (oldpages - 1)];
+      tokstrm->window[i & (oldpages - 1)] = NULL;
+   }
+
+   // Reuse any idle pages, allocate the rest.
+   for(i = spare = 0; i < newpages; i++)
+   {
+      if(window[i])
+         continue;
+
+      while(spare < oldpages && !tokstrm->window[spare])
+         spare++;
+
+      window[i] = spare < oldpages ? tokstrm->window[spare++] : newTokenPage(tokstrm->allocator);
+   }
+
+   gFree(tokstrm->allocator, tokstrm->window);
+   tokstrm->window = window;
+   tokstrm->wpages = newpages;
+}
+
+
+// storeToken
+// Copies t into slot s of page, reusing the slot's string buffer.
+static void storeToken(gTokenStream *tokstrm, gTokenPage *page, int s, const gToken *t)
+{
+   gToken       *slot = &page->tokens[s];
+   unsigned int len;
+
+   *slot = *t;
+
+   if(t->token)
+   {
+      len = strlen(t->token) + 1;
+
+      if(len > page->sizes[s])
+      {
+         page->sizes[s] = len < 16 ? 16 : len;
+         page->strings[s] = gRealloc(tokstrm->allocator, page->strings[s], page->sizes[s]);
+         STAT_ADD(tokstrm, allocations, 1);
+      }
+
+      slot->token = memcpy(page->strings[s], t->token, len);
+   }
+}
+
+
+// addCheckpoint
+// Remembers where the block starting at the next token begins.
+static void addCheckpoint(gTokenStream *tokstrm)
+{
+   gTokenCheckpoint *cp;
+
+   if(tokstrm->ncheckpoints == tokstrm->maxcheckpoints)
+   {
+      tokstrm->maxcheckpoints = tokstrm->maxcheckpoints ? tokstrm->maxcheckpoints * 2 : 16;
+      tokstrm->checkpoints = gRealloc(tokstrm->allocator, tokstrm->checkpoints, 
+                                      sizeof(gTokenCheckpoint) * tokstrm->maxcheckpoints);
+   }
+
+   cp = &tokstrm->checkpoints[tokstrm->ncheckpoints++];
+   cp->position = tokstrm->source.tellsource(tokstrm);
+   cp->linenum = tokstrm->linenum;
+   cp->charnum = tokstrm->charnum;
+}
+
+
+// cacheToken
+// Reads the next token into the slot after clast.
+static void cacheToken(gTokenStream *tokstrm)
+{
+   int          index = tokstrm->clast + 1;
+   gToken       t;
+
+   // The page for this block may still hold the oldest cached block.
+   if(tokstrm->cfirst <= tokstrm->clast && 
+      (index >> TOKENPAGE_SHIFT) - (tokstrm->cfirst >> TOKENPAGE_SHIFT) >= tokstrm->wpages)
+      growWindow(tokstrm);
+
+   if(!(index & TOKENPAGE_MASK) && tokstrm->source.tellsource && 
+      (index >> TOKENPAGE_SHIFT) == tokstrm->ncheckpoints)
+      addCheckpoint(tokstrm);
+
+   nextToken(tokstrm, &t);
+
+   storeToken(tokstrm, tokstrm->window[(index >> TOKENPAGE_SHIFT) & (tokstrm->wpages - 1)], 
+              index & TOKENPAGE_MASK, &t);
+
+   tokstrm->clast = index;
+}
+
+
+// rereadToken
+// Gets an evicted token back by seeking the source to the checkpoint of its
+// block and reading the block (up to cfirst) into the history page. The
+// stream is put back where it was afterwards.
+static gToken *rereadToken(gTokenStream *tokstrm, int index)
+{
+   int              block = index >> TOKENPAGE_SHIFT;
+   int              i, last, linenum, charnum;
+   bool             endofstream;
+   long             position;
+   gTokenCheckpoint *cp;
+   gToken           t;
+
+   if(index < 0)
+      return NULL;
+
+   if(tokstrm->history && index >= tokstrm->hfirst && index <= tokstrm->hlast)
+      return &tokstrm->history->tokens[index & TOKENPAGE_MASK];
+
+   if(!tokstrm->source.seeksource || block >= tokstrm->ncheckpoints)
+      return NULL;
+
+   if(!tokstrm->history)
+      tokstrm->history = newTokenPage(tokstrm->allocator);
+
+   position = tokstrm->source.tellsource(tokstrm);
+   linenum = tokstrm->linenum;
+   charnum = tokstrm->charnum;
+   endofstream = tokstrm->endofstream;
+
+   cp = &tokstrm->checkpoints[block];
+   tokstrm->source.seeksource(tokstrm, cp->position);
+   tokstrm->linenum = cp->linenum;
+   tokstrm->charnum = cp->charnum;
+   tokstrm->endofstream = false;
+
+   // Diagnostics for these tokens were reported the first time around.
+   tokstrm->rereading = true;
+
+   last = (block << TOKENPAGE_SHIFT) + TOKENPAGE_MASK;
+   if(last >= tokstrm->cfirst)
+      last = tokstrm->cfirst - 1;
+
+   for(i = block << TOKENPAGE_SHIFT; i <= last; i++)
+   {
+      tokstrm->source.nexttoken(tokstrm, &t);
+      storeToken(tokstrm, tokstrm->history, i & TOKENPAGE_MASK, &t);
+   }
+
+   tokstrm->rereading = false;
+
+   tokstrm->source.seeksource(tokstrm, position);
+   tokstrm->linenum = linenum;
+   tokstrm->charnum = charnum;
+   tokstrm->endofstream = endofstream;
+
+   tokstrm->hfirst = block << TOKENPAGE_SHIFT;
+   tokstrm->hlast = last;
+
+   return &tokstrm->history->tokens[index & TOKENPAGE_MASK];
+}
+
+
+// The lexer's position is the position in the text stream.
+static long tellLexer(gTokenStream *tokstrm)
 {
-   gTokenStream *ret = (gTokenStream *)malloc(sizeof(gTokenStream));
+   return gTellPos(tokstrm->stream);
+}
+
+
+static void seekLexer(gTokenStream *tokstrm, long position)
+{
+   gSeekPos(tokstrm->stream, (int)position);
+}
+
+
+
+gTokenStream *gCreateCompiledTokenStream(const gCompiledParms *cparms, gTextStream *stream, const char *name)
+{
+   return gCreateCompiledTokenStreamEx(cparms, stream, name, NULL);
+}
+
+
+
+gTokenStream *gCreateCompiledTokenStreamEx(const gCompiledParms *cparms, gTextStream *stream, const char *name, const gAllocator *allocator)
+{
+   gTokenStream *ret;
+
+   if(!cparms || !stream)
+      return NULL;
+
+   if(!allocator)
+      allocator = gGetAllocator();
+
+   ret = (gTokenStream *)gAlloc(allocator, sizeof(gTokenStream));
    memset(ret, 0, sizeof(*ret));
 
+   ret->allocator = allocator;
    ret->stream = stream;
-   ret->parameters = parameters;
-   ret->name = _strdup(name);
-   ret->tokenbuf = malloc(sizeof(qstring_t));
+   ret->compiled = cparms;
+   ret->parameters = &cparms->parms;
+   ret->name = gStrdup(allocator, name);
+   ret->tokenbuf = gAlloc(allocator, sizeof(qstring_t));
    ret->charnum = ret->linenum = 1;
 
-   ret->tcache = gNewList(gFreeToken);
+   ret->window = gAlloc(allocator, sizeof(gTokenPage *));
+   ret->window[0] = newTokenPage(allocator);
+   ret->wpages = 1;
    ret->cfirst = 0; ret->clast = -1;
 
-   M_QStrInitCreate(ret->tokenbuf);
+   ret->source.nexttoken = lexToken;
+   ret->source.tellsource = tellLexer;
+   ret->source.seeksource = seekLexer;
+   ret->hlast = -1;
+
+   M_QStrInitCreateEx(ret->tokenbuf, allocator);
+   gInitDiagnostics(&ret->diagnostics);
+   ret->diagnostics.allocator = allocator;
+
+#ifdef GPARSE_STATS
+   ret->stats = (gTokenStreamStats *)gAlloc(allocator, sizeof(gTokenStreamStats));
+   memset(ret->stats, 0, sizeof(gTokenStreamStats));
+#endif
+
+   return ret;
+}
+
+
+
+gTokenStream *gCreateTokenStream(gTokenParms *parameters, gTextStream *stream, const char *name)
+{
+   return gCreateTokenStreamEx(parameters, stream, name, NULL);
+}
+
+
+
+gTokenStream *gCreateTokenStreamEx(gTokenParms *parameters, gTextStream *stream, const char *name, const gAllocator *allocator)
+{
+   gTokenStream *ret;
+   gCompiledParms *cparms;
+
+   if(!parameters || !stream)
+      return NULL;
+
+   cparms = newCompiledParms(parameters, allocator);
+
+   ret = gCreateCompiledTokenStreamEx(cparms, stream, name, allocator);
+   ret->parameters = parameters;
+   ret->owncompiled = cparms;
 
    return ret;
 }
@@ -140,35 +676,71 @@ gTokenStream *gCreateTokenStream(gTokenParms *parameters, gTextStream *stream, c
 
 void gFreeTokenStream(gTokenStream *tokstrm)
 {
+   if(tokstrm->source.freesource)
+      tokstrm->source.freesource(tokstrm);
+
    if(tokstrm->name)
-      free(tokstrm->name);
+      gFree(tokstrm->allocator, tokstrm->name);
+
+   freeTokenWindow(tokstrm);
+   gFreeDiagnostics(&tokstrm->diagnostics);
+
+   if(tokstrm->stats)
+      gFree(tokstrm->allocator, tokstrm->stats);
 
-   gFreeList(tokstrm->tcache);
    M_QStrFree(tokstrm->tokenbuf);
-   free(tokstrm->tokenbuf);
+   gFree(tokstrm->allocator, tokstrm->tokenbuf);
+
+   if(tokstrm->owncompiled)
+      gFreeCompiledParms(tokstrm->owncompiled);
 
-   free(tokstrm);
+   gFree(tokstrm->allocator, tokstrm);
 }
 
 
 
 void gResetTokenStream(gTokenStream *tokstrm)
 {
-   // Clear the token cache, reset the temporary token buffer.
-   gClearList(tokstrm->tcache);
+   // The source goes first; it may have to stop using the stream.
+   if(tokstrm->source.resetsource)
+      tokstrm->source.resetsource(tokstrm);
 
+   // Reset the temporary token buffer.
    tokstrm->charnum = tokstrm->linenum = 1;
-   tokstrm->tokenbuf->buffer[0] = 0;
+   M_QStrClear(tokstrm->tokenbuf);
+   tokstrm->endofstream = false;
+   gClearDiagnostics(&tokstrm->diagnostics);
 
-   // There are no more cached tokens
+   // Pick up any changes made to the parameters since the stream was created.
+   if(tokstrm->owncompiled)
+   {
+      releaseParms(tokstrm->owncompiled);
+      compileParms(tokstrm->owncompiled, tokstrm->parameters, tokstrm->owncompiled->allocator);
+   }
+
+   // There are no more cached tokens, the window keeps its pages.
    tokstrm->cfirst = 0;
    tokstrm->clast = -1;
+   tokstrm->ncheckpoints = 0;
+   tokstrm->hfirst = 0;
+   tokstrm->hlast = -1;
 
    // Seek the start of the text stream
    gSeekPos(tokstrm->stream, 0);
 }
 
 
+// Fills in a token handed out by reference. The string isn't copied, so it
+// is only valid until the next token is read.
+static void setToken(gToken *out, const char *token, int type, int linenum, int charnum)
+{
+   out->token = (char *)token;
+   out->type = type;
+   out->linenum = linenum;
+   out->charnum = charnum;
+}
+
+
 // Little helper functions.
 static bool isNumeric(char c)
 {
@@ -211,6 +783,7 @@ static void skipWhitespace(gTokenStream *tokstrm, const char *string, int length
 {
    countWhitespace(tokstrm, string, length);
    gSeek(tokstrm->stream, length);
+   STAT_ADD(tokstrm, bytes, length);
 }
 
 
@@ -225,6 +798,7 @@ static void skipChars(gTokenStream *tokstrm, int length)
 {
    countChars(tokstrm, length);
    gSeek(tokstrm->stream, length);
+   STAT_ADD(tokstrm, bytes, length);
 }
 
 
@@ -232,19 +806,63 @@ static void skipChars(gTokenStream *tokstrm, int length)
 
 
 
-static void skipComment(gTokenStream *tokstrm, const char *stop)
+// Returns the number of chars at the start of span which can't begin the end
+// marker of the comment (or the start marker of a nested one).
+static unsigned int commentRun(const gCompiledComment *comment, const char *span, unsigned int len)
+{
+   const char *stop;
+
+   if(!comment->scannable)
+      return 0;
+
+   if((stop = memchr(span, comment->end[0], len)))
+      len = stop - span;
+
+   if(comment->nestable && (stop = memchr(span, comment->start[0], len)))
+      len = stop - span;
+
+   return len;
+}
+
+
+static void skipComment(gTokenStream *tokstrm, const gCompiledComment *comment)
 {
    gTextStream    *stream = tokstrm->stream;
-   gTokenParms    *parms = tokstrm->parameters;
-   const char     *str;
-   int            len = strlen(stop);
+   const gCompiledParms *cparms = tokstrm->compiled;
+   const char     *str, *span;
+   unsigned int   spanlen, run;
+   int            depth = 1;
+   int            len = comment->endlen;
+
+   if(comment->nestable && comment->startlen > len)
+      len = comment->startlen;
    
-   while(!gStreamEnd(stream) && (str = gReadahead(stream, len)))
+   while(!gStreamEnd(stream))
    {
-      if(!parms->strncmp(str, stop, len))
+      // Skip the body of the comment in bulk where possible.
+      if((span = gReadSpan(stream, &spanlen)) && (run = commentRun(comment, span, spanlen)))
       {
-         skipWhitespace(tokstrm, str, len);
+         skipWhitespace(tokstrm, span, run);
+         continue;
+      }
+
+      if(!(str = READAHEAD(tokstrm, len)))
          break;
+
+      if(!cparms->strncmp(str, comment->end, comment->endlen))
+      {
+         skipWhitespace(tokstrm, str, comment->endlen);
+
+         if(--depth == 0)
+            break;
+         continue;
+      }
+
+      if(comment->nestable && !cparms->strncmp(str, comment->start, comment->startlen))
+      {
+         skipWhitespace(tokstrm, str, comment->startlen);
+         depth++;
+         continue;
       }
 
       skipWhitespace(tokstrm, str, 1);
@@ -252,20 +870,20 @@ static void skipComment(gTokenStream *tokstrm, const char *stop)
 }
 
 
-
-
-
-static int checkEscape(const char c, gTokenParms *parms)
+// Returns the index of the longest comment style starting at string, or -1.
+static int matchComment(const gCompiledParms *cparms, const char *string)
 {
-   int i;
-   gEscape *esc;
+   unsigned char c = (unsigned char)string[0];
+   int i, last;
 
-   if(!parms->escapelist)
+   if(cparms->commentfirst[c] == -1)
       return -1;
 
-   for(i = 0; (esc = parms->escapelist + i)->escchar; i++)
+   last = cparms->commentfirst[c] + cparms->commentcount[c];
+
+   for(i = cparms->commentfirst[c]; i < last; i++)
    {
-      if(c == esc->escchar)
+      if(!cparms->strncmp(string, cparms->comments[i].start, cparms->comments[i].startlen))
          return i;
    }
 
@@ -273,10 +891,44 @@ static int checkEscape(const char c, gTokenParms *parms)
 }
 
 
-static gToken *parseString(gTokenStream *tokstrm)
+
+
+
+// Strings are scanned in windows of this many chars so a string with many
+// escapes doesn't rescan the rest of the buffer for every backslash.
+#define STRING_SCANWINDOW 256
+
+// Returns a pointer to the first char in span which ends a run of plain string
+// characters: a quote, a line break or (if escapes is set) a backslash. 
+// Returns NULL if the span contains none of them.
+static const char *findStringStop(const char *span, unsigned int len, bool escapes)
+{
+   const char *stop, *c;
+
+   if((stop = memchr(span, '\"', len)))
+      len = stop - span;
+
+   if((c = memchr(span, '\n', len)))
+   {
+      stop = c;
+      len = c - span;
+   }
+
+   if(escapes && (c = memchr(span, '\\', len)))
+      stop = c;
+
+   return stop;
+}
+
+
+static void parseString(gTokenStream *tokstrm, gToken *out)
 {
    gTextStream    *stream = tokstrm->stream;
-   gTokenParms    *parms = tokstrm->parameters;
+   const gCompiledParms *cparms = tokstrm->compiled;
+   const gTokenParms *parms = &cparms->parms;
+   bool           escapes = (parms->flags & gIgnoreEscapes) ? false : true;
+   const char     *span, *stop;
+   unsigned int   spanlen, run;
    int            linestart, charstart;
 
    linestart = tokstrm->linenum;
@@ -284,28 +936,47 @@ static gToken *parseString(gTokenStream *tokstrm)
 
    M_QStrClear(tokstrm->tokenbuf);
 
-   while(!gStreamEnd(stream))
+   while((span = gReadSpan(stream, &spanlen)))
    {
-      char ch = gReadChar(stream);
+      char ch;
+
+      if(spanlen > STRING_SCANWINDOW)
+         spanlen = STRING_SCANWINDOW;
+
+      // Copy everything up to the next special char in one go.
+      stop = findStringStop(span, spanlen, escapes);
+      run = stop ? stop - span : spanlen;
+
+      if(run)
+      {
+         M_QStrAppendN(tokstrm->tokenbuf, span, run);
+         skipChars(tokstrm, run);
+      }
+
+      if(!stop)
+         continue;
+
+      ch = *stop;
 
       // Don't allow the \n char to be escaped.
       if(ch == '\n')
       {
          // Error
-         parms->setError("%s(%i, %i): Unterminated string literal.\n", tokstrm->name, linestart, charstart);
-         return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+         gReportDiagnostic(tokstrm, gdUnterminatedString, gdError, linestart, charstart, NULL, NULL, 0, 0);
+         setToken(out, M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+         return;
       }
 
       if(ch == '\"')
       {
          skipChars(tokstrm, 1);
-         return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+         setToken(out, M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+         return;
       }
 
-      if(!(parms->flags & gIgnoreEscapes) && ch == '\\')
+      // Escape sequence
       {
-         int index;
-         char *s = gReadahead(stream, 2);
+         char *s = READAHEAD(tokstrm, 2);
 
          if(!s || strlen(s) != 2)
          {
@@ -313,39 +984,29 @@ static gToken *parseString(gTokenStream *tokstrm)
             if(s)
                M_QStrPutc(tokstrm->tokenbuf, *s);
 
-            parms->setError("%s(%i, %i): Unterminated string literal.\n", tokstrm->name, linestart, charstart);
-            return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+            gReportDiagnostic(tokstrm, gdUnterminatedString, gdError, linestart, charstart, NULL, NULL, 0, 0);
+            setToken(out, M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+            return;
          }
 
+         M_QStrPutc(tokstrm->tokenbuf, cparms->escapes[(unsigned char)s[1]]);
          skipChars(tokstrm, 2);
-
-         index = checkEscape(s[1], parms);
-         if(index != -1)
-            M_QStrPutc(tokstrm->tokenbuf, parms->escapelist[index].replacechar);
-         else
-            M_QStrPutc(tokstrm->tokenbuf, s[1]);
-      }
-      else
-      {
-         M_QStrPutc(tokstrm->tokenbuf, ch);
-         skipChars(tokstrm, 1);
       }
    }
 
    // Error
-   parms->setError("%s(%i, %i): Unterminated string literal.\n", tokstrm->name, linestart, charstart);
+   gReportDiagnostic(tokstrm, gdUnterminatedString, gdError, linestart, charstart, NULL, NULL, 0, 0);
 
-   return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
+   setToken(out, M_QStrBuffer(tokstrm->tokenbuf), tString, linestart, charstart);
 }
 
 
 
 
 
-static gToken *parseHex(gTokenStream *tokstrm)
+static void parseHex(gTokenStream *tokstrm, gToken *out)
 {
    gTextStream    *stream = tokstrm->stream;
-   gTokenParms    *parms = tokstrm->parameters;
    int            linestart, charstart;
    char           *str;
 
@@ -354,12 +1015,21 @@ static gToken *parseHex(gTokenStream *tokstrm)
 
    M_QStrClear(tokstrm->tokenbuf);
 
-   str = gReadahead(stream, 3);
+   str = READAHEAD(tokstrm, 3);
 
    if(!str || strlen(str) != 3)
    {
-      parms->setError("%s(%i, %i): Expected a Hex value after '0x'", tokstrm->name, linestart, charstart);
-      return gCreateToken(str, tHexInt, linestart, charstart);
+      gReportDiagnostic(tokstrm, gdExpectedHex, gdError, linestart, charstart, NULL, NULL, 0, 0);
+
+      // Consume what's there so the same token isn't found again.
+      if(str)
+      {
+         M_QStrCat(tokstrm->tokenbuf, str);
+         skipChars(tokstrm, strlen(str));
+      }
+
+      setToken(out, M_QStrBuffer(tokstrm->tokenbuf), tHexInt, linestart, charstart);
+      return;
    }
 
    M_QStrCat(tokstrm->tokenbuf, str);
@@ -378,14 +1048,14 @@ static gToken *parseHex(gTokenStream *tokstrm)
       break;
    }
 
-   return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), tHexInt, linestart, charstart);
+   setToken(out, M_QStrBuffer(tokstrm->tokenbuf), tHexInt, linestart, charstart);
 }
 
 
 
 
 
-static int checkKeyword(const char *token, gTokenParms *parms)
+static int checkKeyword(const char *token, const gTokenParms *parms)
 {
    int i;
    gKeyword *kw;
@@ -405,10 +1075,10 @@ static int checkKeyword(const char *token, gTokenParms *parms)
 
 
 
-static gToken *parseIdentifier(gTokenStream *tokstrm)
+static void parseIdentifier(gTokenStream *tokstrm, gToken *out)
 {
    gTextStream    *stream = tokstrm->stream;
-   gTokenParms    *parms = tokstrm->parameters;
+   const gTokenParms *parms = &tokstrm->compiled->parms;
    int            linestart, charstart, index;
    int            type = tIdentifier;
 
@@ -431,10 +1101,10 @@ static gToken *parseIdentifier(gTokenStream *tokstrm)
    }
 
    // Check here for constants.
-   index = checkKeyword(M_QStrBuffer(tokstrm->tokenbuf), tokstrm->parameters);
+   index = checkKeyword(M_QStrBuffer(tokstrm->tokenbuf), parms);
    if(index != -1)
    {
-      gKeyword *kw = &tokstrm->parameters->keywlist[index];
+      gKeyword *kw = &parms->keywlist[index];
 
       type = kw->newtype;
 
@@ -442,22 +1112,20 @@ static gToken *parseIdentifier(gTokenStream *tokstrm)
          M_QStrSet(tokstrm->tokenbuf, kw->newtoken);
    }
 
-   return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
+   setToken(out, M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
 }
 
 
 
-int checkSymbol(gTokenParms *parms, char *string)
+static int checkSymbol(const gCompiledParms *cparms, const char *string)
 {
-   int len = strlen(string);
    int i;
    gSymbol *s;
 
-   if(!parms->symbollist || !len)
-      return -1;
-
-   for(i = 0; (s = parms->symbollist + i)->token[0] != 0; i++)
+   for(i = cparms->symbolfirst[(unsigned char)string[0]]; i != -1; i = cparms->symbolnext[i])
    {
+      s = cparms->parms.symbollist + i;
+
       if(s->token[0] == string[0] && !s->token[1])
          return i;
 
@@ -477,10 +1145,9 @@ int checkSymbol(gTokenParms *parms, char *string)
 
 
 
-static gToken *parseNumber(gTokenStream *tokstrm)
+static void parseNumber(gTokenStream *tokstrm, gToken *out)
 {
    gTextStream    *stream = tokstrm->stream;
-   gTokenParms    *parms = tokstrm->parameters;
    int            linestart, charstart;
    int            type = tInteger;
 
@@ -530,8 +1197,9 @@ static gToken *parseNumber(gTokenStream *tokstrm)
 
             if(gStreamEnd(stream) || !isNumeric(ch))
             {
-               parms->setError("%s(%i, %i): Expected numeric value in exponent.", tokstrm->name, linestart, charstart);
-               return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
+               gReportDiagnostic(tokstrm, gdExpectedExponent, gdError, linestart, charstart, NULL, NULL, 0, 0);
+               setToken(out, M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
+               return;
             }
 
             while(!gStreamEnd(stream) && isNumeric(ch))
@@ -540,31 +1208,30 @@ static gToken *parseNumber(gTokenStream *tokstrm)
                skipChars(tokstrm, 1);
                ch = gReadChar(stream);
             }
-
-            gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
          }
       }
 
       break;
    }
 
-   return gCreateToken(M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
+   setToken(out, M_QStrBuffer(tokstrm->tokenbuf), type, linestart, charstart);
 }
 
 
 
 
 
-gToken *gGetNextToken(gTokenStream *tokstrm)
+// Finds the next token in the stream and fills in out. The token string 
+// points into the token buffer or the parms, so it has to be copied if the
+// token needs to outlive the next call.
+static void lexToken(gTokenStream *tokstrm, gToken *out)
 {
    gTextStream    *stream = tokstrm->stream;
-   gTokenParms    *parms = tokstrm->parameters;
+   const gCompiledParms *cparms = tokstrm->compiled;
+   const gTokenParms *parms = &cparms->parms;
 
    char           rover, *string;
-   gToken         *ret;
-   int            max, len, index, stringlen;
-
-   parms->strncmp = (parms->flags & gIgnoreCase) ? _strnicmp : strncmp;
+   int            index, stringlen;
 
    while(!gStreamEnd(stream))
    {
@@ -577,25 +1244,19 @@ gToken *gGetNextToken(gTokenStream *tokstrm)
 
          if(rover == '\n' && parms->flags & gNewlineTokens)
          {
-            gToken *t = gCreateToken("", tLineBreak, tokstrm->linenum, tokstrm->charnum);
+            setToken(out, "", tLineBreak, tokstrm->linenum, tokstrm->charnum);
             skipWhitespace(tokstrm, &rover, 1);
-            return t;
+            return;
          }
 
          skipWhitespace(tokstrm, &rover, 1);
+         STAT_ADD(tokstrm, whitespacebytes, 1);
       }
 
       if(!rover)
          break;
 
-      // Determine the maximum read-ahead we need
-      max = 3;
-      if(parms->comment1s && (len = strlen(parms->comment1s)) > max)
-         max = len;
-      if(parms->comment2s && (len = strlen(parms->comment2s)) > max)
-         max = len;
-
-      string = gReadahead(stream, max);
+      string = READAHEAD(tokstrm, cparms->maxlookahead);
 
       if(!string)
          break;
@@ -604,27 +1265,17 @@ gToken *gGetNextToken(gTokenStream *tokstrm)
 
       // Check comments. If a comment is encountered, the whitespace check 
       // needs to run again
-      if(parms->comment1s && parms->comment1e)
-      {
-         len = strlen(parms->comment1s);
-
-         if(!parms->strncmp(string, parms->comment1s, len))
-         {
-            skipWhitespace(tokstrm, string, len);
-            skipComment(tokstrm, parms->comment1e);
-            continue;
-         }
-      }
-      if(parms->comment2s && parms->comment2e)
+      if((index = matchComment(cparms, string)) != -1)
       {
-         len = strlen(parms->comment2s);
-
-         if(!parms->strncmp(parms->comment2s, string, len))
-         {
-            skipWhitespace(tokstrm, string, len);
-            skipComment(tokstrm, parms->comment2e);
-            continue;
-         }
+         const gCompiledComment *comment = &cparms->comments[index];
+#ifdef GPARSE_STATS
+         guint64 start = tokstrm->stats->bytes;
+#endif
+
+         skipWhitespace(tokstrm, string, comment->startlen);
+         skipComment(tokstrm, comment);
+         STAT_ADD(tokstrm, commentbytes, tokstrm->stats->bytes - start);
+         continue;
       }
 
       // Detect various token types.
@@ -632,39 +1283,34 @@ gToken *gGetNextToken(gTokenStream *tokstrm)
       {
          // String literal
          skipChars(tokstrm, 1);
-         return parseString(tokstrm);
+         STAT_PARSE(tokstrm, gsParseString, parseString(tokstrm, out));
+         return;
       }
       else if(stringlen >= 2 && string[0] == '0' && string[1] == 'x')
       {
          // Hex number
-         if((ret = parseHex(tokstrm)))
-            return ret;
-
-         break;
+         STAT_PARSE(tokstrm, gsParseHex, parseHex(tokstrm, out));
+         return;
       }
       else if(isNumeric(string[0]) || (string[0] == '.' && isNumeric(string[1])))
       {
-         if((ret = parseNumber(tokstrm)))
-            return ret;
-         break;
+         STAT_PARSE(tokstrm, gsParseNumber, parseNumber(tokstrm, out));
+         return;
       }
-      else if((index = checkSymbol(tokstrm->parameters, string)) != -1)
+      else if((index = checkSymbol(cparms, string)) != -1)
       {
-         gSymbol *symbol = &tokstrm->parameters->symbollist[index];
-         gToken  *tok = gCreateToken(symbol->token, symbol->newtype, tokstrm->linenum, tokstrm->charnum);
+         gSymbol *symbol = &parms->symbollist[index];
 
-         // Symbols could contain return chars in them.
-         skipWhitespace(tokstrm, tok->token, strlen(tok->token));
+         setToken(out, symbol->token, symbol->newtype, tokstrm->linenum, tokstrm->charnum);
 
-         if(tok)
-            return tok;
-         break;
+         // Symbols could contain return chars in them.
+         skipWhitespace(tokstrm, symbol->token, strlen(symbol->token));
+         return;
       }
       else if(isAlphaNumeric(string[0]) || string[0] == '_')
       {
-         if((ret = parseIdentifier(tokstrm)))
-            return ret;
-         break;
+         STAT_PARSE(tokstrm, gsParseIdentifier, parseIdentifier(tokstrm, out));
+         return;
       }
       // Add more types!
       else if(!(parms->flags & gIgnoreUnknowns))
@@ -672,9 +1318,10 @@ gToken *gGetNextToken(gTokenStream *tokstrm)
          // SoM: TODO: some times comment terminators such as '*/' will trigger 
          // this error message. Something should really be done about this.
 
-         parms->setError("%s(%i, %i): Unknown char encountered.\n", tokstrm->name, tokstrm->linenum, tokstrm->charnum);
+         gReportDiagnostic(tokstrm, gdUnknownChar, gdError, tokstrm->linenum, tokstrm->charnum, NULL, NULL, 0, 0);
          // Skip the char
          gGetChar(stream);
+         STAT_ADD(tokstrm, bytes, 1);
          continue;
       }
 
@@ -682,52 +1329,147 @@ gToken *gGetNextToken(gTokenStream *tokstrm)
    }
 
    tokstrm->endofstream = true;
-   return gCreateToken("end of file", tEOF, tokstrm->linenum, tokstrm->charnum);
+   setToken(out, "end of file", tEOF, tokstrm->linenum, tokstrm->charnum);
 }
 
 
 
+// nextToken
+// Gets the next token from the token source and counts it.
+static void nextToken(gTokenStream *tokstrm, gToken *out)
+{
+#ifdef GPARSE_STATS
+   unsigned int bufsize = tokstrm->tokenbuf->size;
 
-gToken *gGetToken(gTokenStream *tokstrm, int index)
+   tokstrm->source.nexttoken(tokstrm, out);
+
+   if(tokstrm->tokenbuf->size != bufsize)
+      tokstrm->stats->allocations++;
+
+   if(out->type >= 0 && out->type < tLastBaseToken)
+      tokstrm->stats->tokens[out->type]++;
+   else
+      tokstrm->stats->usertokens++;
+#else
+   tokstrm->source.nexttoken(tokstrm, out);
+#endif
+}
+
+
+
+gToken *gGetNextToken(gTokenStream *tokstrm)
 {
-   int i;
+   gToken t;
 
-   if(index < tokstrm->cfirst)
+   nextToken(tokstrm, &t);
+   STAT_ADD(tokstrm, allocations, 1);
+
+   return gCreateTokenEx(t.token, t.type, t.linenum, t.charnum, tokstrm->allocator);
+}
+
+
+
+int gTokenizeEach(gTokenStream *tokstrm, gTokenCallback callback, void *userdata)
+{
+   gToken t;
+   int    count = 0;
+
+   if(!tokstrm || !callback)
+      return 0;
+
+   while(!tokstrm->endofstream)
    {
-      // Can't go back in the token stream.
-      return NULL;
+      nextToken(tokstrm, &t);
+
+      if(t.type == tEOF)
+         break;
+
+      count++;
+
+      if(!callback(&t, userdata))
+         break;
    }
-   else if(index > tokstrm->clast)
-   {
-      // Cache new tokens until the end of the stream.
-      int count = index - tokstrm->clast;
 
-      for(i = 0; i < count; i++)
-      {
-         if(tokstrm->endofstream)
-            return tokstrm->tcache->list[tokstrm->tcache->size - 1];
+   return count;
+}
 
-         gAppendListItem(tokstrm->tcache, gGetNextToken(tokstrm));
-         tokstrm->clast++;
-      }
+
+
+
+gToken *gGetToken(gTokenStream *tokstrm, int index)
+{
+   // Evicted tokens have to be read again.
+   if(index < tokstrm->cfirst)
+      return rereadToken(tokstrm, index);
+
+   // Cache new tokens until the end of the stream.
+   while(index > tokstrm->clast)
+   {
+      if(tokstrm->endofstream)
+         return windowToken(tokstrm, tokstrm->clast);
+
+      cacheToken(tokstrm);
    }
 
-   return tokstrm->tcache->list[index - tokstrm->cfirst];
+   return windowToken(tokstrm, index);
 }
 
 
 
 void gClearTCache(gTokenStream *tokstrm)
 {
-   if(tokstrm->cfirst == tokstrm->clast)
-      return;
+   // Leave at least one token in the stream at all times please. :)
+   if(tokstrm->cfirst < tokstrm->clast)
+      tokstrm->cfirst = tokstrm->clast;
+}
+
+
+
+void gTrimTCache(gTokenStream *tokstrm, int index)
+{
+   if(index > tokstrm->clast)
+      index = tokstrm->clast;
+
+   if(index > tokstrm->cfirst)
+      tokstrm->cfirst = index;
+}
+
+
+
+bool gGetTokenStreamStats(const gTokenStream *tokstrm, gTokenStreamStats *stats)
+{
+   if(!tokstrm->stats)
+   {
+      memset(stats, 0, sizeof(*stats));
+      return false;
+   }
 
-   // size - 1 is the last item in the list... hehe. Leave at least one token
-   // in the stream at all times please. :)
-   gDeleteListRange(tokstrm->tcache, 0, tokstrm->tcache->size - 2);
-   tokstrm->cfirst = tokstrm->clast;
+   *stats = *tokstrm->stats;
+   return true;
 }
 
 
 
+// gReportDiagnostic
+// Records a diagnostic. Text is only produced for an installed setError.
+void gReportDiagnostic(gTokenStream *tokstrm, int code, int severity, int linenum, int charnum,
+                       const char *sarg0, const char *sarg1, int iarg0, int iarg1)
+{
+   const gDiagnostic *d;
+   char  text[1025];
+
+   if(tokstrm->rereading)
+      return;
+
+   d = gAddDiagnostic(&tokstrm->diagnostics, code, severity, tokstrm->name, linenum, charnum, 
+                      sarg0, sarg1, iarg0, iarg1);
+
+   if(tokstrm->parameters->setError && tokstrm->parameters->setError != errorNOP)
+   {
+      gFormatDiagnostic(d, text, sizeof(text));
+      tokstrm->parameters->setError("%s", text);
+   }
+}
+
+
 
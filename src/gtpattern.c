@@ -76,10 +76,10 @@ bool opCompType(tpHookParms *parms, int steptype)
 // Token bank parsing aids.
 
 
-tpStackEntry *newStackEntry(int startIndex, tpErrHook efunc)
+// Stack entries live in place in the pattern's inline stack.
+tpStackEntry *newStackEntry(tPattern *p, int startIndex, tpErrHook efunc)
 {
-   tpStackEntry *ret = malloc(sizeof(tpStackEntry));
-   memset(ret, 0, sizeof(*ret));
+   tpStackEntry *ret = gPushInlineEntry(p->stack);
 
    ret->backIndex = ret->stepIndex = startIndex;
    ret->errHook = efunc;
@@ -94,23 +94,115 @@ tpStackEntry *newStackEntry(int startIndex, tpErrHook efunc)
 // Creates a new tPattern object for use with the parsing functions.
 tPattern *tpNewPattern(tpStep *stepList, gTokenStream *tstream)
 {
-   int i;
-   tPattern *ret = malloc(sizeof(tPattern));
-   memset(ret, 0, sizeof(*ret));
+   return tpNewPatternEx(stepList, tstream, tstream ? tstream->allocator : NULL);
+}
+
+
+// isJump
+// True if the action code moves execution to the step's subLabel.
+static bool isJump(int action)
+{
+   int code = action & scCodeMask;
+
+   return code == scPush || code == scGoto;
+}
+
+
+
+// linkError
+// Reports a problem found while linking. Link errors aren't tied to a token,
+// so the step index is passed instead of a position.
+static void linkError(tPattern *p, int code, int stepIndex, const char *label)
+{
+   if(p->tstream)
+      gReportDiagnostic(p->tstream, code, gdFatal, 0, 0, label, NULL, stepIndex, 0);
+
+   p->linkErrors++;
+}
+
 
-   ret->stepList = stepList;
-   ret->tstream = tstream;
 
-   ret->stack = gNewStack(free);
+// linkPattern
+// Resolves the subLabel of every step that can push or goto to a step index,
+// and checks every action code, so the interpreter never looks up a label.
+static void linkPattern(tPattern *p)
+{
+   tpStep            *stepList = p->stepList;
+   gStaticHashTable  *labelTable;
+   tpStep            *substep;
+   const char        **labels;
+   void              **steps;
+   int               i, stepCount, count;
+
+   for(stepCount = 0, count = 0; stepList[stepCount].stepOp != NULL; stepCount++)
+   {
+      if(stepList[stepCount].label)
+         count++;
+   }
 
-   // Build labeltable.
-   ret->labelTable = gNewHashTable(71, NULL, true);
-   for(i = 0; stepList[i].stepOp != NULL; i++)
+   labels = gAlloc(p->allocator, sizeof(char *) * (count + 1));
+   steps = gAlloc(p->allocator, sizeof(void *) * (count + 1));
+
+   for(i = 0, count = 0; i < stepCount; i++)
    {
       if(stepList[i].label)
-         gAddTableItem(ret->labelTable, stepList[i].label, stepList + i);
+      {
+         labels[count] = stepList[i].label;
+         steps[count++] = stepList + i;
+      }
+   }
+
+   // Labels are case insensitive.
+   labelTable = gBuildStaticHashTableEx(labels, steps, count, true, p->allocator);
+
+   gFree(p->allocator, labels);
+   gFree(p->allocator, steps);
+
+   p->targets = gAlloc(p->allocator, sizeof(int) * (stepCount + 1));
+
+   for(i = 0; i < stepCount; i++)
+   {
+      tpStep *step = stepList + i;
+
+      p->targets[i] = -1;
+
+      if((step->onTrue & scCodeMask) > scEnd || (step->onFalse & scCodeMask) > scEnd)
+         linkError(p, gdPatternBadOp, i, NULL);
+      else if(!isJump(step->onTrue) && !isJump(step->onFalse))
+         continue;
+      else if(!step->subLabel)
+         linkError(p, gdPatternNoLabel, i, NULL);
+      else if(!(substep = gFindStaticItem(labelTable, step->subLabel)))
+         linkError(p, gdPatternBadLabel, i, step->subLabel);
+      else
+         p->targets[i] = (int)(substep - stepList);
    }
 
+   gFreeStaticHashTable(labelTable);
+}
+
+
+
+// tpNewPatternEx
+// Same as tpNewPattern, allocating everything with the given allocator.
+tPattern *tpNewPatternEx(tpStep *stepList, gTokenStream *tstream, const gAllocator *allocator)
+{
+   tPattern *ret;
+
+   if(!allocator)
+      allocator = gGetAllocator();
+
+   ret = gAlloc(allocator, sizeof(tPattern));
+   memset(ret, 0, sizeof(*ret));
+
+   ret->allocator = allocator;
+   ret->stepList = stepList;
+   ret->tstream = tstream;
+
+   ret->stack = gNewInlineStackEx(sizeof(tpStackEntry), NULL, allocator);
+
+   linkPattern(ret);
+
    return ret;
 }
 
@@ -138,10 +230,10 @@ void tpFreePattern(tPattern *p)
    if(p->tstream)
       gFreeTokenStream(p->tstream);
 
-   if(p->labelTable)
-      gFreeHashTable(p->labelTable);
+   if(p->targets)
+      gFree(p->allocator, p->targets);
 
-   free(p);
+   gFree(p->allocator, p);
 }
 
 
@@ -173,22 +265,23 @@ int tpIncrementCount(tPattern *p, int code)
 
 
 
+// setError
+// Records the error thrown by a step. The message is kept unformatted along
+// with the token, see gdiagnostic.h::gFormatDiagnostic.
 static void setError(tPattern *p, const char *msg, int elevel, gToken *t)
 {
-   gTokenStream *ts = p->tstream;
-   char ebuf[1025];
+   int severity;
 
-   if(!elevel)
+   if(elevel == tpWarning)
+      severity = gdWarning;
+   else if(elevel == tpError)
+      severity = gdError;
+   else if(elevel == tpFatal)
+      severity = gdFatal;
+   else
       return;
 
-   _snprintf(ebuf, 1024, msg, t->token);
-
-   if(elevel == tpWarning)
-      ts->parameters->setError("Warning %s(%i, %i): %s\n", ts->name, t->linenum, t->charnum, ebuf);
-   if(elevel == tpError)
-      ts->parameters->setError("Error %s(%i, %i): %s\n", ts->name, t->linenum, t->charnum, ebuf);
-   if(elevel == tpFatal)
-      ts->parameters->setError("Fatal Error %s(%i, %i): %s\n", ts->name, t->linenum, t->charnum, ebuf);
+   gReportDiagnostic(p->tstream, gdPatternThrow, severity, t->linenum, t->charnum, msg, t->token, 0, 0);
 }
 
 
@@ -221,11 +314,12 @@ int tpExecutePattern(tPattern *p)
 {
    tpStackEntry *top;
    gTokenStream *ts;
-   tpStep       *step, *substep;
+   tpStep       *step;
    gToken       *t;
-   gList        *tlist = gNewList(NULL);
+   gList        *tlist = gNewListEx(NULL, p->allocator);
    int          ret = tpNoError;
    int          hookret;
+   int          stored = 0;
 
    tpHookParms  hp;
 
@@ -237,12 +331,20 @@ int tpExecutePattern(tPattern *p)
 
    ts = p->tstream;
 
+   // The link errors were reported when the pattern was created, only the
+   // summary is left.
+   if(p->linkErrors)
+   {
+      p->ecount = p->linkErrors;
+      ret = tpFatal;
+      goto finish;
+   }
+
    // Make sure the stack is empty and create the first entry
-   if(p->stack->top)
-      gClearStack(p->stack);
+   gClearStack(p->stack);
 
    // Create the first stack entry
-   gPushEntry(p->stack, top = newStackEntry(p->i, NULL));
+   top = newStackEntry(p, p->i, NULL);
 
    while((t = gGetToken(p->tstream, p->i)) != NULL)
    {
@@ -270,7 +372,12 @@ int tpExecutePattern(tPattern *p)
       flags &= ~scCodeMask;
 
       if(flags & sfStore)
+      {
+         if(!gGetListSize(tlist))
+            stored = p->i;
+
          gAppendListItem(tlist, t);
+      }
       if(flags & sfSetFB)
          top->fallbackIndex = top->backIndex = top->stepIndex;
 
@@ -314,24 +421,6 @@ int tpExecutePattern(tPattern *p)
          continue;
       }
 
-      // If the code is label related, make sure the label is valid!
-      if(code == scPush || code == scGoto)
-      {
-         char *label = step->subLabel;
-         if(!label)
-         {
-            ret = tpFatal;
-            ts->parameters->setError("Pattern error: Step with an opcode requiring a label had no label.\n");
-            goto finish;
-         }
-         else if(!(substep = gFindTableItem(p->labelTable, label)))
-         {
-            ret = tpFatal;
-            ts->parameters->setError("Pattern error: Label '%s' not found in pattern.\n", label);
-            goto finish;
-         }
-      }
-
       switch(code)
       {
          case scEnd:
@@ -352,27 +441,25 @@ int tpExecutePattern(tPattern *p)
             else
                top->stepIndex ++;
 
-            gPushEntry(p->stack, top = newStackEntry(substep - p->stepList, top->errHook));
+            top = newStackEntry(p, p->targets[step - p->stepList], top->errHook);
             break;
          case scGoto:
-            top->stepIndex = substep - p->stepList;
-            break;
-         default:
-            ts->parameters->setError("Internal error: tpRunPattern: step op unhandled/unrecognized.");
-            ret = tpFatal;
-            p->ecount++;
-            goto finish;
+            top->stepIndex = p->targets[top->stepIndex];
             break;
       }
 
       if(!(flags & sfStay))
          p->i++;
+
+      // Nothing refers to tokens before the current one or the first stored
+      // one any more. Evicting whole blocks lets the window reuse its pages.
+      gTrimTCache(ts, (gGetListSize(tlist) && stored < p->i ? stored : p->i) & ~(GTOKEN_BLOCKSIZE - 1));
    }
 
    // Out of tokens but NOT out of the stack?
-   if(p->stack->top)
+   if(gGetStackSize(p->stack))
    {
-      ts->parameters->setError("%s: Unexpected EOF", ts->name);
+      gReportDiagnostic(ts, gdPatternEOF, gdFatal, ts->linenum, ts->charnum, NULL, NULL, 0, 0);
       p->ecount++;
       ret = tpFatal;
    }
@@ -382,7 +469,7 @@ int tpExecutePattern(tPattern *p)
    // Couple of things. First, if there were warnings or errors, set another 
    // error message.
    if(p->wcount > 0 || p->ecount > 0)
-      ts->parameters->setError("%s: %i Errors, %i Warnings", ts->name, p->ecount, p->wcount);
+      gReportDiagnostic(ts, gdPatternSummary, gdNote, 0, 0, NULL, NULL, p->ecount, p->wcount);
 
    // Clean up
    gFreeList(tlist);
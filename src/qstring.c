@@ -21,7 +21,7 @@
 // Reallocating string structure
 //
 // What this "class" guarantees:
-// * The string will always be null-terminated
+// * M_QStrBuffer always returns a null-terminated string
 // * Indexing functions always check array bounds
 // * Insertion functions always reallocate when needed
 //
@@ -50,8 +50,15 @@
 
 
 qstring_t *M_QStrInitCreate(qstring_t *qstr)
+{
+   return M_QStrInitCreateEx(qstr, NULL);
+}
+
+
+qstring_t *M_QStrInitCreateEx(qstring_t *qstr, const gAllocator *allocator)
 {
    memset(qstr, 0, sizeof(*qstr));
+   qstr->allocator = allocator ? allocator : gGetAllocator();
 
    return M_QStrCreate(qstr);
 }
@@ -59,10 +66,13 @@ qstring_t *M_QStrInitCreate(qstring_t *qstr)
 
 qstring_t *M_QStrCreateSize(qstring_t *qstr, unsigned int size)
 {
-   qstr->buffer = realloc(qstr->buffer, size);
+   if(size < 1)
+      size = 1;
+
+   qstr->buffer = gRealloc(qstr->allocator, qstr->buffer, size);
    qstr->size   = size;
    qstr->index  = 0;
-   memset(qstr->buffer, 0, size);
+   qstr->buffer[0] = '\0';
 
    return qstr;
 }
@@ -76,7 +86,7 @@ qstring_t *M_QStrCreate(qstring_t *qstr)
 
 unsigned int M_QStrLen(qstring_t *qstr)
 {
-   return strlen(qstr->buffer);
+   return qstr->index;
 }
 
 
@@ -88,26 +98,42 @@ unsigned int M_QStrSize(qstring_t *qstr)
 
 char *M_QStrBuffer(qstring_t *qstr)
 {
+   // The terminator is only written when somebody looks.
+   qstr->buffer[qstr->index] = '\0';
    return qstr->buffer;
 }
 
 
 qstring_t *M_QStrGrow(qstring_t *qstr, unsigned int len)
 {   
-   int newsize = qstr->size + len;
-
-   qstr->buffer = realloc(qstr->buffer, newsize);
-   memset(qstr->buffer + qstr->size, 0, len);
+   qstr->buffer = gRealloc(qstr->allocator, qstr->buffer, qstr->size + len);
    qstr->size += len;
    
    return qstr;
 }
 
 
+//
+// M_QStrReserve
+//
+// Makes sure len more characters and the terminator fit, at least
+// doubling the buffer when it has to grow.
+//
+qstring_t *M_QStrReserve(qstring_t *qstr, unsigned int len)
+{
+   unsigned int need = qstr->index + len + 1;
+
+   if(need > qstr->size)
+      M_QStrGrow(qstr, need > qstr->size * 2 ? need - qstr->size : qstr->size);
+
+   return qstr;
+}
+
+
 qstring_t *M_QStrClear(qstring_t *qstr)
 {
-   memset(qstr->buffer, 0, qstr->size);
    qstr->index = 0;
+   qstr->buffer[0] = '\0';
 
    return qstr;
 }
@@ -115,7 +141,7 @@ qstring_t *M_QStrClear(qstring_t *qstr)
 
 void M_QStrFree(qstring_t *qstr)
 {
-   free(qstr->buffer);
+   gFree(qstr->allocator, qstr->buffer);
    qstr->buffer = NULL;
    qstr->index = qstr->size = 0;
 }
@@ -123,7 +149,7 @@ void M_QStrFree(qstring_t *qstr)
 
 char M_QStrCharAt(qstring_t *qstr, unsigned int idx)
 {
-   if(idx >= qstr->size)
+   if(idx >= qstr->index)
       return 0;
 
    return qstr->buffer[idx];
@@ -132,7 +158,7 @@ char M_QStrCharAt(qstring_t *qstr, unsigned int idx)
 
 qstring_t *M_QStrPutc(qstring_t *qstr, char ch)
 {
-   if(qstr->index >= qstr->size - 1) // leave room for \0
+   if(qstr->index + 1 >= qstr->size) // leave room for \0
       M_QStrGrow(qstr, qstr->size);  // double buffer size
 
    qstr->buffer[qstr->index++] = ch;
@@ -143,19 +169,14 @@ qstring_t *M_QStrPutc(qstring_t *qstr, char ch)
 
 qstring_t *M_QStrInsertc(qstring_t *qstr, char ch, unsigned int index)
 {
-   //unsigned int i;
    char         *b;
 
    if(index >= qstr->index)
       return M_QStrPutc(qstr, ch);
 
-   if(qstr->index >= qstr->size - 1) // leave room for \0
-      M_QStrGrow(qstr, qstr->size);  // double buffer size
+   M_QStrReserve(qstr, 1);
 
    b = qstr->buffer + index;
-
-   //for(i = qstr->index; i > index; i--)
-   //   qstr->buffer[i] = qstr->buffer[i - 1];
    memmove(b + 1, b, qstr->index - index); 
 
    *b = ch;
@@ -168,20 +189,7 @@ qstring_t *M_QStrInsertc(qstring_t *qstr, char ch, unsigned int index)
 
 qstring_t *M_QStrDeletec(qstring_t *qstr, unsigned int index)
 {
-   char *b;
-
-   if(index >= qstr->index - 1)
-   {
-      qstr->index--;
-      qstr->buffer[qstr->index] = '\0';
-      return qstr;
-   }
-
-   b = qstr->buffer + index;
-   memmove(b, b + 1, qstr->index - index);
-
-   qstr->index --;
-   return qstr;
+   return M_QStrDeleteRange(qstr, index, 1);
 }
 
 
@@ -192,11 +200,10 @@ qstring_t *M_QStrDeleteRange(qstring_t *qstr, unsigned int index, unsigned int l
    if(index >= qstr->index)
       return qstr;
 
-   if(index + len > qstr->index)
+   if(len > qstr->index - index)
       len = qstr->index - index;
 
    memmove(b + index, b + index + len, qstr->index - index - len);
-   memset(b + (qstr->index - len), 0, len);
 
    qstr->index -= len;
 
@@ -208,60 +215,39 @@ qstring_t *M_QStrDeleteRange(qstring_t *qstr, unsigned int index, unsigned int l
 
 qstring_t *M_QStrCat(qstring_t *qstr, const char *str)
 {
-   unsigned int cursize = qstr->size;
-   unsigned int newsize = strlen(qstr->buffer) + strlen(str) + 1;
-
-   if(newsize > cursize)
-      M_QStrGrow(qstr, newsize - cursize);
-
-   strcat(qstr->buffer, str);
-
-   qstr->index = newsize - 1;
-
-   return qstr;
+   return M_QStrAppendN(qstr, str, (unsigned int)strlen(str));
 }
 
 
-// -- From m_misc.c in Eternity ---
-// haleyjd: portable strupr function
-static char *M_Strupr(char *string)
+qstring_t *M_QStrAppendN(qstring_t *qstr, const char *str, unsigned int len)
 {
-   char *s = string;
+   M_QStrReserve(qstr, len);
 
-   while(*s)
-   {
-      char c = *s;
-      *s++ = toupper(c);
-   }
+   memcpy(qstr->buffer + qstr->index, str, len);
+   qstr->index += len;
 
-   return string;
-}
-
-// haleyjd: portable strlwr function
-static char *M_Strlwr(char *string)
-{
-   char *s = string;
-
-   while(*s)
-   {
-      char c = *s;
-      *s++ = tolower(c);
-   }
-
-   return string;
+   return qstr;
 }
 
 
 qstring_t *M_QStrUpr(qstring_t *qstr)
 {
-   M_Strupr(qstr->buffer);
+   char *s = qstr->buffer, *end = s + qstr->index;
+
+   for(; s < end; s++)
+      *s = toupper(*s);
+
    return qstr;
 }
 
 
 qstring_t *M_QStrLwr(qstring_t *qstr)
 {
-   M_Strlwr(qstr->buffer);
+   char *s = qstr->buffer, *end = s + qstr->index;
+
+   for(; s < end; s++)
+      *s = tolower(*s);
+
    return qstr;
 }
 
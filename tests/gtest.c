@@ -0,0 +1,384 @@
+// Emacs style mode select -*- C++ -*-
+// ----------------------------------------------------------------------------
+//
+// Copyright(C) 2009 Stephen McGranahan
+//
+// This file is part of gParse
+//
+// gParse is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Limited General Public License as published 
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+// 
+// ----------------------------------------------------------------------------
+//
+// gParse is a text file parsing system which operates with a few basic
+// behaviors predefined, and others optionalized. This creates a token 
+// generator that is at once very simple to use and works well for most
+// situations.
+//
+// ----------------------------------------------------------------------------
+
+
+
+// gtest
+// Regression tests for gParse. Each test is a function returning true if it
+// passed. Run without arguments to run them all in this process, with a 
+// test name to run just that one, or with -l to list the names.
+
+#include "gparse.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// CHECK
+// Fails the current test, printing the condition, if cond is false.
+#define CHECK(cond) \
+   if(!(cond)) { printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); return false; } else (void)0
+
+
+// ----------------------------------------------------------------------------
+// Helpers
+
+static gTokenStream *openMemory(gTokenParms *parms, const char *text)
+{
+   return gCreateTokenStream(parms, gStreamFromMemory((char *)text, (int)strlen(text), false), "test");
+}
+
+static void closeStream(gTokenStream *tokstrm)
+{
+   gTextStream *stream = tokstrm->stream;
+
+   gFreeTokenStream(tokstrm);
+   gFreeStream(stream);
+}
+
+
+// countAllocator
+// Allocator that keeps track of the bytes it has outstanding.
+
+static size_t allocated;
+
+static void *countAlloc(void *context, size_t size)
+{
+   size_t *p = (size_t *)malloc(sizeof(size_t) * 2 + size);
+
+   allocated += size;
+   *p = size;
+   return p + 2;
+}
+
+static void *countRealloc(void *context, void *ptr, size_t size)
+{
+   size_t *p = ptr ? (size_t *)ptr - 2 : NULL;
+
+   allocated += size - (p ? *p : 0);
+   p = (size_t *)realloc(p, sizeof(size_t) * 2 + size);
+   *p = size;
+   return p + 2;
+}
+
+static void countFree(void *context, void *ptr)
+{
+   if(ptr)
+   {
+      allocated -= ((size_t *)ptr)[-2];
+      free((size_t *)ptr - 2);
+   }
+}
+
+static const gAllocator countAllocator = {countAlloc, countRealloc, countFree, NULL};
+
+
+// ----------------------------------------------------------------------------
+// ghashtable
+
+// Removed keys stay in the key arena until it's packed. A table that only
+// ever adds and removes unique keys used to grow without bound.
+static bool testHashKeyChurn(void)
+{
+   gHashTable  *table;
+   char        key[32];
+   size_t      peak = 0;
+   int         i;
+
+   allocated = 0;
+   table = gNewHashTableEx(16, NULL, false, &countAllocator);
+
+   for(i = 0; i < 500000; i++)
+   {
+      sprintf(key, "key%d", i);
+      CHECK(gAddTableItem(table, key, table));
+      CHECK(gRemoveTableItem(table, key));
+
+      if(allocated > peak)
+         peak = allocated;
+   }
+
+   CHECK(table->itemCount == 0);
+
+   // Half a million keys take about 5M of arena, the table itself needs
+   // a few K.
+   CHECK(peak < 256 * 1024);
+
+   // Keys added before a pack must still be found after it.
+   for(i = 0; i < 1000; i++)
+   {
+      sprintf(key, "keep%d", i);
+      CHECK(gAddTableItem(table, key, table));
+   }
+   for(i = 0; i < 100000; i++)
+   {
+      sprintf(key, "key%d", i);
+      CHECK(gAddTableItem(table, key, table));
+      CHECK(gRemoveTableItem(table, key));
+   }
+   for(i = 0; i < 1000; i++)
+   {
+      sprintf(key, "keep%d", i);
+      CHECK(gFindTableItem(table, key) == table);
+   }
+
+   gFreeHashTable(table);
+   CHECK(allocated == 0);
+   return true;
+}
+
+
+static int sharedFrees;
+
+static void countSharedFree(void *object)
+{
+   sharedFrees++;
+}
+
+
+// Every change to a shared table retires a copy of it. With a registered
+// reader that keeps entering and leaving, the copies have to be freed as 
+// the writes go, not kept until the table is freed.
+static bool testSharedReclaim(void)
+{
+   gSharedHashTable  *shared;
+   gSharedReader     *reader;
+   gHashTable        *table;
+   char              key[32];
+   int               held = 1, other = 2;
+   size_t            peak = 0;
+   int               i;
+
+   allocated = 0;
+   sharedFrees = 0;
+   table = gNewHashTableEx(16, countSharedFree, false, &countAllocator);
+   for(i = 0; i < 100; i++)
+   {
+      sprintf(key, "key%d", i);
+      CHECK(gAddTableItem(table, key, &other));
+   }
+
+   shared = gShareHashTable(table);
+   reader = gAddSharedReader(shared);
+
+   for(i = 0; i < 10000; i++)
+   {
+      gEnterShared(reader);
+      CHECK(gFindSharedItem(shared, "key50") == &other);
+      gLeaveShared(reader);
+
+      CHECK(gAddSharedItem(shared, "churn", &other));
+      CHECK(gRemoveSharedItem(shared, "churn"));
+
+      if(allocated > peak)
+         peak = allocated;
+   }
+
+   // Ten thousand copies of a hundred items would be megabytes.
+   CHECK(peak < 64 * 1024);
+   CHECK(sharedFrees == 10000);
+
+   // An object removed while the reader is inside stays until it leaves.
+   CHECK(gAddSharedItem(shared, "held", &held));
+   gEnterShared(reader);
+   CHECK(gFindSharedItem(shared, "held") == &held);
+   CHECK(gRemoveSharedItem(shared, "held"));
+   for(i = 0; i < 10; i++)
+   {
+      CHECK(gAddSharedItem(shared, "churn", &other));
+      CHECK(gRemoveSharedItem(shared, "churn"));
+   }
+   CHECK(sharedFrees == 10000);
+   gLeaveShared(reader);
+   gReclaimSharedTable(shared);
+   CHECK(sharedFrees == 10011);
+
+   gRemoveSharedReader(reader);
+   gFreeSharedHashTable(shared);
+   CHECK(allocated == 0);
+   return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// gtokencache
+
+static int errorCalls;
+
+static void countError(const char *fmt, ...)
+{
+   errorCalls++;
+}
+
+
+// readCached
+// Opens path through the token cache and reads it to the end, counting the
+// setError calls made while opening and while reading.
+static bool readCached(const char *path, gTokenParms *parms, int *opencalls, int *readcalls, int *records)
+{
+   gTokenStream   *tokstrm;
+   gToken         *t;
+   int            i = 0;
+
+   errorCalls = 0;
+   if(!(tokstrm = gOpenCachedTokenStream(path, parms)))
+      return false;
+   *opencalls = errorCalls;
+
+   errorCalls = 0;
+   while((t = gGetToken(tokstrm, i))->type != tEOF)
+      i++;
+   *readcalls = errorCalls;
+   *records = gGetDiagnosticCount(&tokstrm->diagnostics);
+
+   gFreeTokenStream(tokstrm);
+   return true;
+}
+
+
+// Lexer errors have to come out of a cached stream the same way whether the
+// cache was just built or was already there.
+static bool testCacheDiagnostics(void)
+{
+   const char     *path = "gtest-cache.txt";
+   char           cachepath[64];
+   gTokenParms    *parms = gNewParms();
+   FILE           *f;
+   int            pass, opencalls, readcalls, records;
+
+   sprintf(cachepath, "%s%s", path, GTOKCACHE_EXT);
+   remove(cachepath);
+
+   CHECK((f = fopen(path, "wb")) != NULL);
+   // One unknown char and one unterminated string.
+   fputs("a 1\nb ` 2\nc \"open\nd 3\n", f);
+   fclose(f);
+
+   parms->setError = countError;
+
+   for(pass = 0; pass < 2; pass++)
+   {
+      CHECK(readCached(path, parms, &opencalls, &readcalls, &records));
+      CHECK(opencalls == 0);
+      CHECK(readcalls == 2);
+      CHECK(records == 2);
+   }
+
+   remove(path);
+   remove(cachepath);
+   gFreeParms(parms);
+   return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// gpipeline
+
+// The lexer thread quits after the end entry. Rereading an evicted token 
+// asks the source for its position first, which used to wait forever for
+// an entry that would never come.
+static bool testPipelineRereadAfterEnd(void)
+{
+   gTokenParms    *parms = gNewParms();
+   gTokenStream   *tokstrm = openMemory(parms, "a b c d e f g h");
+   gToken         *t;
+   int            count = 0;
+
+   CHECK(gStartTokenPipeline(tokstrm, 4));
+
+   while((t = gGetToken(tokstrm, count))->type != tEOF)
+      count++;
+   CHECK(count == 8);
+
+   gClearTCache(tokstrm);
+
+   t = gGetToken(tokstrm, 3);
+   CHECK(t && !strcmp(t->token, "d"));
+
+   // Reading on after the reread still ends the stream.
+   t = gGetToken(tokstrm, count);
+   CHECK(t && t->type == tEOF);
+
+   closeStream(tokstrm);
+   gFreeParms(parms);
+   return true;
+}
+
+
+// ----------------------------------------------------------------------------
+
+typedef struct
+{
+   const char  *name;
+   bool        (*func)(void);
+} testEntry;
+
+static testEntry tests[] =
+{
+   {"hash-key-churn", testHashKeyChurn},
+   {"shared-reclaim", testSharedReclaim},
+   {"pipeline-reread-after-end", testPipelineRereadAfterEnd},
+   {"cache-diagnostics", testCacheDiagnostics},
+   {NULL, NULL}
+};
+
+
+int main(int argc, char **argv)
+{
+   int i, failed = 0, run = 0;
+
+   for(i = 0; tests[i].name; i++)
+   {
+      if(argc > 1 && !strcmp(argv[1], "-l"))
+      {
+         printf("%s\n", tests[i].name);
+         continue;
+      }
+
+      if(argc > 1 && strcmp(argv[1], tests[i].name))
+         continue;
+
+      run++;
+      if(tests[i].func())
+         printf("ok   %s\n", tests[i].name);
+      else
+      {
+         printf("FAIL %s\n", tests[i].name);
+         failed++;
+      }
+   }
+
+   if(argc > 1 && strcmp(argv[1], "-l") && !run)
+   {
+      printf("unknown test '%s'\n", argv[1]);
+      return 2;
+   }
+
+   return failed ? 1 : 0;
+}
@@ -94,6 +94,14 @@ LINK32=link.exe
 # PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
 # Begin Source File
 
+SOURCE=..\src\galloc.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\gdiagnostic.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\ghashtable.c
 # End Source File
 # Begin Source File
@@ -106,6 +114,14 @@ SOURCE=.\gParse.rc
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\gparsefiles.c
+# End Source File
+# Begin Source File
+
+SOURCE=..\src\gpipeline.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\gstack.c
 # End Source File
 # Begin Source File
@@ -114,6 +130,10 @@ SOURCE=..\src\gtextstream.c
 # End Source File
 # Begin Source File
 
+SOURCE=..\src\gtokencache.c
+# End Source File
+# Begin Source File
+
 SOURCE=..\src\gtokenize.c
 # End Source File
 # Begin Source File
@@ -130,10 +150,18 @@ SOURCE=..\src\qstring.c
 # PROP Default_Filter "h;hpp;hxx;hm;inl"
 # Begin Source File
 
+SOURCE=..\include\galloc.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\gbool.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\gdiagnostic.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\ghashtable.h
 # End Source File
 # Begin Source File
@@ -146,6 +174,14 @@ SOURCE=..\include\gparse.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\gparsefiles.h
+# End Source File
+# Begin Source File
+
+SOURCE=..\include\gpipeline.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\gstack.h
 # End Source File
 # Begin Source File
@@ -154,6 +190,10 @@ SOURCE=..\include\gtextstream.h
 # End Source File
 # Begin Source File
 
+SOURCE=..\include\gtokencache.h
+# End Source File
+# Begin Source File
+
 SOURCE=..\include\gtokenize.h
 # End Source File
 # Begin Source File